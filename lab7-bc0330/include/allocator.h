@@ -40,6 +40,7 @@ void buddy_init();
 void *startup_alloc(size_t size);
 void *allocate(size_t size);
 void free(void *addr);
+// the buddy/chunk primitives below expect alloc_lock to be held
 void *page_alloc(size_t num_pages);
 void free_page(void *addr);
 void *chunck_alloc(size_t size);
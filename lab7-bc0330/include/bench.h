@@ -0,0 +1,14 @@
+#ifndef __BENCH_H__
+#define __BENCH_H__
+
+#define BENCH_THREADS 512   // kernel threads created by the spawn benchmark
+#define BENCH_BATCH   32    // threads alive at the same time
+#define BENCH_FORKS   1000  // iterations of the EL0 fork loop in bench_user.S
+#define BENCH_RT_LOOPS       1000 // timed sleeps of the RT latency benchmark
+#define BENCH_RT_INTERVAL_US 1000 // length of each sleep
+
+#ifndef __ASSEMBLER__
+void bench_main(void);
+#endif
+
+#endif
@@ -17,5 +17,7 @@ typedef struct devfs_internal {
 } devfs_internal_t;
 
 struct filesystem *devfs_create(void);
+int devfs_register(const char *name, struct file_operations *fops);
+int devfs_register_data(const char *name, struct file_operations *fops, void *data);
 
 #endif
\ No newline at end of file
@@ -41,6 +41,7 @@ struct fdt_prop_descriptor {
 
 void initramfs_callback(char *);
 void fdt_traverse(void (* callback)(char *));
+void *fdt_get_property(const char *name);
 
 
 #endif
\ No newline at end of file
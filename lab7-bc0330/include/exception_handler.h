@@ -7,15 +7,31 @@
 #include "mmu.h"
 
 #define IRQ_PENDING_1        (PBASE + 0x0000B204)
+#define ENABLE_IRQS_1        (PBASE + 0x0000B210)
+#define AUX_IRQ              (1 << 29)   // mini UART, GPU IRQ 29
 #define CORE0_TIMER_IRQ_CTRL (0x40000040 + KERNEL_VIRTUAL_BASE)
 #define CORE0_IRQ_SRC        (0x40000060 + KERNEL_VIRTUAL_BASE)
 
+/*
+    Mini UART rings. The RX ring has a single writer per index: the RX
+    interrupt advances read_rear and uart_getc() read_front, and the data
+    is stored before the index that publishes it, so it takes no lock.
+    The TX ring is not lock-free: uart_send() advances write_rear, and
+    the TX interrupt write_front, except when the ring is full, where
+    uart_send() sends the oldest character itself and advances
+    write_front too. uart_send() does all of this with interrupts masked,
+    which keeps the TX interrupt out and serializes callers in thread and
+    interrupt context.
+*/
 extern char read_buffer[MAX_BUFFER_SIZE];
 extern char write_buffer[MAX_BUFFER_SIZE];
-extern int read_front;
-extern int read_rear;
-extern int write_front;
-extern int write_rear;
+extern volatile int read_front;
+extern volatile int read_rear;
+extern volatile int write_front;
+extern volatile int write_rear;
+extern struct wait_queue_head uart_read_wait;  // readers waiting for RX data
+
+#define uart_ring_barrier() asm volatile ("dmb ish\n" : : : "memory")
 
 typedef struct trapframe {
     unsigned long x[31];
@@ -30,21 +46,10 @@ unsigned long disable_interrupt(void);
 void sync_handler(trapframe_t *tf);
 
 void *load_user_program(void *entry, void *stack);
-void irq_handler(void);
+void irq_handler(trapframe_t *tf);
 void receive_handler(void);
 void transmit_handler(void);
 void timer_handler(void);
 void syscall_handler(trapframe_t *tf);
-void handle_signal();
-
-void sigreturn(void);
-void switch_to_signal_handler(
-    unsigned long *normal_context,
-    unsigned long *signal_context,
-    void *handler_stack,
-    void *handler,
-    void *kernel_stack,
-    void *kernel_stack_base
-);
 
 #endif
\ No newline at end of file
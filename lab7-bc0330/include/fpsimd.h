@@ -0,0 +1,38 @@
+#ifndef __FPSIMD_H__
+#define __FPSIMD_H__
+
+#include "smp.h"
+#include "thread.h"
+
+// CPACR_EL1.FPEN: which exception levels trap on FP/SIMD instructions
+#define CPACR_FPEN_SHIFT    20
+#define CPACR_FPEN_MASK     (3UL << CPACR_FPEN_SHIFT)
+#define CPACR_FPEN_EL0_TRAP (1UL << CPACR_FPEN_SHIFT) // EL1 may use FP/SIMD, EL0 traps
+#define CPACR_FPEN_NO_TRAP  (3UL << CPACR_FPEN_SHIFT)
+
+/*
+    Lazy FP/SIMD switching. The kernel is built with -mgeneral-regs-only,
+    so the V registers only ever hold user state. EL0 traps on its first
+    FP/SIMD instruction after a switch; the trap saves the registers of
+    whichever thread last used them on this CPU and loads the current
+    thread's, which then runs without traps until it is switched out.
+    A thread that never touches FP/SIMD gets no state area and pays nothing.
+*/
+struct fpsimd_state {
+    __uint128_t vregs[32];
+    unsigned int fpsr;
+    unsigned int fpcr;
+} __attribute__((aligned(16)));
+
+extern thread_t *fpsimd_owner[NR_CPUS]; // thread whose state is in the registers
+
+void fpsimd_save_state(struct fpsimd_state *state);
+void fpsimd_load_state(const struct fpsimd_state *state);
+
+void fpsimd_init(void);
+void fpsimd_switch(thread_t *next);
+void do_fpsimd_acc(void);
+int fpsimd_fork(thread_t *child, thread_t *parent);
+void fpsimd_release(thread_t *t);
+
+#endif
@@ -0,0 +1,35 @@
+#ifndef __FUTEX_H__
+#define __FUTEX_H__
+
+#include "spinlock.h"
+#include "thread.h"
+
+#define FUTEX_WAIT 0
+#define FUTEX_WAKE 1
+
+#define FUTEX_HASH_BITS 5
+#define FUTEX_HASH_SIZE (1 << FUTEX_HASH_BITS)
+
+/*
+    Fast user-space mutex support. A waiter is keyed on the physical
+    address of the user word, so threads mapping the same page at
+    different addresses meet in the same queue. The hash buckets keep
+    their own lists because a wake must only hit waiters of one key.
+*/
+typedef struct futex_q {
+    struct futex_q *next;
+    thread_t *task;
+    unsigned long key;      // physical address of the user word
+    int woken;              // dequeued by futex_wake()
+} futex_q_t;
+
+typedef struct futex_bucket {
+    spinlock_t lock;
+    futex_q_t *head;
+} futex_bucket_t;
+
+void futex_init(void);
+long futex_wait(unsigned int *uaddr, unsigned int val, unsigned long timeout);
+long futex_wake(unsigned int *uaddr, int nr_wake);
+
+#endif
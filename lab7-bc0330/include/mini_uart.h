@@ -22,8 +22,14 @@ However, the reference uses bus addresses. You should translate them into physic
 #define AUX_MU_STAT_REG (PBASE + 0x00215064)
 #define AUX_MU_BAUD_REG (PBASE + 0x00215068)
 
+// AUX_MU_IER_REG
+#define AUX_MU_IER_RX   0x1     // a received byte is waiting
+#define AUX_MU_IER_TX   0x2     // the transmit FIFO is empty
+
 void uart_init(void);
+void uart_enable_interrupts(void);
 char uart_recv(void);
+int uart_getc(void);
 void uart_send(char c);
 void uart_send_num(unsigned long num, char *form);
 void uart_send_string(char *str);
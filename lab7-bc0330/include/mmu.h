@@ -10,6 +10,9 @@
 #define PUD_GRANULARITY     0x40000000   // 1GB
 #define PGD_GRANULARITY     0x8000000000 // 512GB
 
+#define PERIPHERAL_START    0x3C000000   // window mapped into every user address space
+#define PERIPHERAL_END      0x3F000000
+
 #define TCR_CONFIG_REGION_48bit (((64 - 48) << 0) | ((64 - 48) << 16))
 #define TCR_CONFIG_4KB ((0b00 << 14) |  (0b10 << 30))
 #define TCR_CONFIG_DEFAULT (TCR_CONFIG_REGION_48bit | TCR_CONFIG_4KB)
@@ -38,6 +41,10 @@
 
 void finer_granularity_paging(void);
 void mappages (unsigned long *page_table, unsigned long vaddr, unsigned long paddr, unsigned long attr);
+void unmappages(unsigned long *pgd, unsigned long vaddr);
+void switch_pgd(unsigned long *pgd);
+unsigned long walk_addr(unsigned long *pgd, unsigned long vaddr);
 void setup_thread_peripherals(unsigned long *pgd);
+void free_page_tables(unsigned long *pgd);
 
 #endif
@@ -0,0 +1,26 @@
+#ifndef __PID_H__
+#define __PID_H__
+
+#include "thread.h"
+
+#define PID_MAX        1024                 // ids 0 .. PID_MAX-1
+#define PID_HASH_BITS  6
+#define PID_HASH_SIZE  (1 << PID_HASH_BITS)
+#define PID_INVALID    ((pid_t)-1)
+
+/*
+    Thread ids come from a bitmap and are recycled after the thread is
+    reaped. Searching starts after the last id handed out, so an id is not
+    reused right away and a stale kill() is unlikely to hit a new thread.
+    Every live thread, running, blocked or zombie, is in a hash table
+    keyed on its id, chained through thread_t.pid_next.
+*/
+void init_pid(void);
+pid_t alloc_pid(void);
+void free_pid(pid_t pid);
+void attach_pid(thread_t *t);
+void detach_pid(thread_t *t);
+thread_t *find_thread_by_pid(pid_t pid);
+void for_each_thread(void (*fn)(thread_t *t, void *arg), void *arg);
+
+#endif
@@ -0,0 +1,42 @@
+#ifndef __PIPE_H__
+#define __PIPE_H__
+
+#include <stddef.h>
+#include "vfs.h"
+#include "wait.h"
+
+/*
+    Pipes. The data lives in a ring of up to PIPE_BUFFERS pages, each with
+    the range [offset, offset + len) still unread. A write appends to the
+    newest page while it has room and otherwise adds a page; a read copies
+    from the oldest one and frees it once drained. Bytes never move inside
+    the pipe, only whole pages enter and leave the ring: a write of a
+    page or more fills a fresh page outside the lock and gifts it to the
+    ring, so the lock is never held across more than one page of copying.
+
+    Readers sleep on rd_wait until data arrives or the last writer is
+    gone (end of file); writers sleep on wr_wait until there is room.
+    Writing with no reader left sends SIGPIPE and fails.
+*/
+#define PIPE_BUFFERS 16  // pages per pipe, a power of two
+
+struct pipe_buffer {
+    char *page;            // allocate(PAGE_SIZE)
+    unsigned int offset;   // first unread byte
+    unsigned int len;      // unread bytes
+};
+
+typedef struct pipe {
+    struct pipe_buffer bufs[PIPE_BUFFERS];
+    unsigned int head;     // next slot to fill, runs freely
+    unsigned int tail;     // oldest slot, runs freely
+    int readers;           // open read ends
+    int writers;           // open write ends
+    wait_queue_head_t rd_wait;
+    wait_queue_head_t wr_wait;
+    struct vnode vnode;    // shared by both ends, internal points back here
+} pipe_t;
+
+int pipe_create(struct file **read_end, struct file **write_end);
+
+#endif
@@ -0,0 +1,42 @@
+#ifndef __POLL_H__
+#define __POLL_H__
+
+#include <stddef.h>
+#include "thread.h"
+#include "vfs.h"
+#include "wait.h"
+
+/*
+    Readiness multiplexing. poll() asks every file for its ready events
+    through the poll file operation, which also hands poll_wait() the
+    wait queue its events are signalled on. If nothing is ready the
+    caller sleeps on all those queues at once, and every wakeup scans
+    the files again, until one is ready, the timeout expires or a kill
+    or signal arrives. Files without a poll operation are always
+    readable and writable, like regular files.
+*/
+#define POLLIN   0x001  // a read won't block
+#define POLLOUT  0x004  // a write won't block
+#define POLLERR  0x008  // error, e.g. nobody reads the pipe; always reported
+#define POLLHUP  0x010  // the other end is gone; always reported
+#define POLLNVAL 0x020  // fd is not open; always reported
+
+#define POLL_TABLE_SIZE MAX_FD  // one queue per file descriptor
+
+struct pollfd {
+    int fd;             // negative: ignored
+    short events;       // requested
+    short revents;      // returned
+};
+
+typedef struct poll_table {
+    int registering;    // only the first scan queues us, later ones just check
+    int nr;
+    wait_queue_head_t *queues[POLL_TABLE_SIZE];
+    wait_queue_entry_t entries[POLL_TABLE_SIZE];
+} poll_table_t;
+
+void poll_wait(wait_queue_head_t *wq, poll_table_t *pt);
+int do_poll(struct pollfd *fds, unsigned int nfds, long timeout_ms);
+
+#endif
@@ -0,0 +1,40 @@
+#ifndef __RBTREE_H__
+#define __RBTREE_H__
+
+#include <stddef.h>
+
+#define RB_RED   0
+#define RB_BLACK 1
+
+/*
+    Intrusive red-black tree: the node is embedded in the owning structure
+    and the caller does the ordered descent itself, then links the new node
+    and lets rb_insert_color() rebalance.
+*/
+typedef struct rb_node {
+    struct rb_node *parent;
+    struct rb_node *left;
+    struct rb_node *right;
+    int color;
+} rb_node_t;
+
+typedef struct rb_root {
+    rb_node_t *node;
+} rb_root_t;
+
+#define rb_entry(ptr, type, member) ((type *)((char *)(ptr) - offsetof(type, member)))
+
+static inline void rb_link_node(rb_node_t *node, rb_node_t *parent, rb_node_t **link) {
+    node->parent = parent;
+    node->left = NULL;
+    node->right = NULL;
+    node->color = RB_RED;
+    *link = node;
+}
+
+void rb_insert_color(rb_node_t *node, rb_root_t *root);
+void rb_erase(rb_node_t *node, rb_root_t *root);
+rb_node_t *rb_first(const rb_root_t *root);
+rb_node_t *rb_next(const rb_node_t *node);
+
+#endif
@@ -0,0 +1,87 @@
+#ifndef __SCHEDSTAT_H__
+#define __SCHEDSTAT_H__
+
+#include <stddef.h>
+#include "thread.h"
+#include "timer.h"
+
+/*
+    Scheduler statistics, always on. Every thread counts its run time, its
+    time waiting in a run queue and how often it was switched out; two
+    global log2 histograms record how long a woken or preempted thread
+    waited for the CPU and how long switch_to() took. The numbers are
+    readable from /dev/schedstat (any write clears the histograms) and
+    with the "schedstat" shell command.
+
+    Histogram bucket 0 counts samples below 256 ns, bucket i samples in
+    [128 << i, 256 << i) ns; the last bucket is open-ended.
+*/
+#define SCHEDSTAT_BUCKETS  24
+#define SCHEDSTAT_BUF_SIZE 4096  // rendered report, truncated beyond this
+
+typedef struct sched_hist {
+    unsigned long count[SCHEDSTAT_BUCKETS];
+    unsigned long samples;
+    unsigned long total_ns;
+    unsigned long max_ns;
+} sched_hist_t;
+
+// text writer shared by the statistics devices; output past size is dropped
+typedef struct stat_buf {
+    char *buf;
+    size_t size;
+    size_t len;
+} stat_buf_t;
+
+/*
+    A report in /dev: every read renders it again into a buf_size buffer,
+    any write calls reset.
+*/
+typedef struct stat_dev {
+    size_t (*render)(char *buf, size_t size);
+    void (*reset)(void);
+    size_t buf_size;
+} stat_dev_t;
+
+extern sched_hist_t rq_latency_hist;   // queued until running
+extern sched_hist_t switch_cost_hist;  // switch_to() until the next thread runs
+
+static inline void schedstat_clear(thread_t *t) {
+    t->run_ticks = 0;
+    t->wait_ticks = 0;
+    t->nr_voluntary = 0;
+    t->nr_involuntary = 0;
+    t->nr_migrations = 0;
+    t->last_arrival = 0;
+    t->last_queued = 0;
+    t->user_ticks = 0;
+    t->cutime_ticks = 0;
+    t->cstime_ticks = 0;
+}
+
+/*
+    User time: stamped on every return to EL0 and charged on the next
+    exception from it. A thread is never switched out at EL0, so the rest
+    of run_ticks is system time.
+*/
+static inline void acct_return_to_user(thread_t *t) {
+    t->user_enter = read_cntpct();
+}
+
+static inline void acct_enter_kernel(thread_t *t) {
+    t->user_ticks += read_cntpct() - t->user_enter;
+}
+
+void schedstat_init(void);
+void schedstat_record(sched_hist_t *hist, unsigned long ticks);
+void schedstat_clear_hist(sched_hist_t *hist);
+void thread_cputime(thread_t *t, unsigned long *utime, unsigned long *stime);
+void schedstat_reset(void);
+size_t schedstat_render(char *buf, size_t size);
+void stat_puts(stat_buf_t *b, const char *s);
+void stat_putnum(stat_buf_t *b, unsigned long num);
+void stat_render_hist(stat_buf_t *b, const char *name, sched_hist_t *hist);
+int stat_dev_register(const char *name, const stat_dev_t *dev);
+void print_sched_stats(void);
+
+#endif
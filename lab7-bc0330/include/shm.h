@@ -0,0 +1,43 @@
+#ifndef __SHM_H__
+#define __SHM_H__
+
+#include <stddef.h>
+#include "thread.h"
+
+/*
+    Shared memory segments. shm_open() finds or creates a named segment
+    and returns its id; shm_attach() maps the segment's pages into the
+    caller and returns the address, so every process attaching it sees
+    the same physical pages. Attachment i of a process lives at
+    SHM_USER_BASE + i * SHM_MAX_SIZE, and fork() passes them all on to
+    the child, which makes a segment attached before fork an anonymous
+    shared mapping between parent and child.
+
+    A segment is freed when nothing refers to it any more: every
+    attachment holds a reference, and the name holds one until
+    shm_unlink(). exec() and exit detach everything.
+*/
+#define SHM_USER_BASE     0x200000000UL // above the uring page
+#define SHM_MAX_SIZE      0x100000      // 1 MB per segment
+#define SHM_MAX_SEGMENTS  16
+#define SHM_NAME_LEN      15
+
+// shm_open() flags
+#define SHM_CREAT  1                    // create it if the name is unused
+#define SHM_EXCL   2                    // with SHM_CREAT: fail if it exists
+
+typedef struct shm_segment {
+    char name[SHM_NAME_LEN + 1];
+    void *mem;                          // allocate()d, size bytes
+    size_t size;                        // whole pages
+    int refs;                           // attachments, plus one for the name
+} shm_segment_t;
+
+long shm_open(const char *name, size_t size, int flags);
+long shm_attach(int id);
+int shm_detach(unsigned long addr);
+int shm_unlink(const char *name);
+void shm_fork(thread_t *child);
+void shm_release(thread_t *t);
+
+#endif
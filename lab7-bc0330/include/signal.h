@@ -0,0 +1,54 @@
+#ifndef __SIGNAL_H__
+#define __SIGNAL_H__
+
+#include "exception_handler.h"
+#include "fpsimd.h"
+#include "thread.h"
+
+/*
+    POSIX-style signals. Every process has its own handler table and a
+    pending and a blocked mask, one bit per signal. A signal is delivered
+    on the way back to EL0: the interrupted trapframe (and the FP/SIMD
+    registers, if the process uses them) is pushed onto the user stack
+    together with a two-instruction sigreturn trampoline, and the handler
+    is entered with x0 = signum and lr pointing at the trampoline. Nothing
+    is allocated; a process without pending signals pays one test in
+    exit_to_user().
+
+    As in the lab's user programs SIGKILL may be caught, but it can't be
+    blocked, so a SIGKILL without a handler always terminates the target.
+*/
+#define SIGKILL     9
+#define SIGPIPE     13  // write to a pipe nobody reads
+
+#define SIG_DFL     ((void *)0)  // terminate the process
+#define SIG_IGN     ((void *)1)  // discard the signal
+
+// sigprocmask() how
+#define SIG_BLOCK   0
+#define SIG_UNBLOCK 1
+#define SIG_SETMASK 2
+
+#define sigmask(sig) (1UL << (sig))
+
+struct sigframe {
+    trapframe_t tf;             // interrupted user context
+    unsigned long blocked;      // blocked mask to restore
+    unsigned long fp_valid;     // fp holds the FP/SIMD registers
+    unsigned int trampoline[4]; // mov x8, #10; svc #0
+    struct fpsimd_state fp;
+} __attribute__((aligned(16)));
+
+static inline int signal_pending(thread_t *t) {
+    return (t->sig_pending & ~t->sig_blocked) != 0;
+}
+
+void signal_init(thread_t *t);
+void signal_exec(thread_t *t);
+int send_signal(thread_t *t, int sig);
+void *signal_set_handler(int sig, void *handler);
+int signal_procmask(int how, const unsigned long *set, unsigned long *oldset);
+void do_signal(trapframe_t *tf);
+void do_sigreturn(trapframe_t *tf);
+
+#endif
@@ -0,0 +1,15 @@
+#ifndef __SMP_H__
+#define __SMP_H__
+
+#define NR_CPUS 4 // Cortex-A53 cores on the BCM2837; only core 0 is brought up so far
+#define CPU_MASK_ALL ((1UL << NR_CPUS) - 1)
+
+extern unsigned long cpu_online_mask; // bit n: core n runs the scheduler
+
+static inline unsigned int smp_processor_id(void) {
+    unsigned long mpidr;
+    asm volatile ("mrs %0, mpidr_el1\n" : "=r" (mpidr));
+    return mpidr & 0xFF; // Aff0: core number within the cluster
+}
+
+#endif
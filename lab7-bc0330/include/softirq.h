@@ -0,0 +1,48 @@
+#ifndef __SOFTIRQ_H__
+#define __SOFTIRQ_H__
+
+#include <stddef.h>
+#include "smp.h"
+
+/*
+    Bottom halves. An interrupt handler only acknowledges the hardware and
+    raises a softirq; the pending softirqs run when the outermost handler
+    exits, with interrupts enabled, so a slow one no longer holds off
+    other interrupts. They must not sleep and must take their locks with
+    spin_lock_irqsave(). Work that keeps being raised is handed to the
+    ksoftirqd thread after MAX_SOFTIRQ_RESTART rounds.
+
+    Tasklets are dynamically registered bottom halves on top of
+    TASKLET_SOFTIRQ; a tasklet that is scheduled again before it runs
+    still runs once.
+*/
+enum {
+    TIMER_SOFTIRQ,      // expired timers and the scheduler tick
+    TASKLET_SOFTIRQ,
+    NR_SOFTIRQS
+};
+
+#define MAX_SOFTIRQ_RESTART 10
+
+#define TASKLET_STATE_SCHED 1   // queued, not yet running
+
+struct tasklet_struct {
+    struct tasklet_struct *next;
+    int state;
+    void (*func)(unsigned long data);
+    unsigned long data;
+};
+
+#define DECLARE_TASKLET(name, fn, d) \
+    struct tasklet_struct name = { NULL, 0, fn, d }
+
+void softirq_init(void);
+void open_softirq(int nr, void (*action)(void));
+void raise_softirq(int nr);
+void irq_exit(void);
+int in_softirq(void);
+
+void tasklet_init(struct tasklet_struct *t, void (*func)(unsigned long data), unsigned long data);
+void tasklet_schedule(struct tasklet_struct *t);
+
+#endif
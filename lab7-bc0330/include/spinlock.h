@@ -0,0 +1,154 @@
+#ifndef __SPINLOCK_H__
+#define __SPINLOCK_H__
+
+#include "exception_handler.h"
+
+/*
+    Ticket spinlock. A locker takes a ticket by atomically incrementing
+    next and spins until owner reaches its ticket, so waiters get the lock
+    in FIFO order. Both halves live in one word so LDAXR/STXR can update
+    next while reading owner; waiters sleep in WFE and are woken by the
+    store-release of the unlocker clearing their exclusive monitor.
+
+    Building with LOCK_STAT=1 (CONFIG_LOCK_STAT) adds per-lock counters
+    for acquisitions, contention, spin time and hold time.
+*/
+typedef struct arch_spinlock {
+    volatile unsigned short owner;  // ticket currently holding the lock
+    volatile unsigned short next;   // next ticket to hand out
+} __attribute__((aligned(4))) arch_spinlock_t;
+
+typedef struct spinlock {
+    arch_spinlock_t raw;
+#ifdef CONFIG_LOCK_STAT
+    const char *name;
+    struct spinlock *stat_next;     // list of locks that have been taken
+    int registered;
+    unsigned long acquired;         // number of acquisitions
+    unsigned long contended;        // acquisitions that had to spin
+    unsigned long wait_ticks;       // total counter ticks spent spinning
+    unsigned long max_wait;
+    unsigned long hold_ticks;       // total counter ticks the lock was held
+    unsigned long max_hold;
+    unsigned long hold_start;
+#endif
+} spinlock_t;
+
+#ifdef CONFIG_LOCK_STAT
+#define __SPIN_LOCK_INIT(lockname) { .raw = { 0, 0 }, .name = lockname }
+#else
+#define __SPIN_LOCK_INIT(lockname) { .raw = { 0, 0 } }
+#endif
+
+#define DEFINE_SPINLOCK(x) spinlock_t x = __SPIN_LOCK_INIT(#x)
+
+static inline void arch_spin_lock(arch_spinlock_t *lock) {
+    unsigned int lockval, newval, tmp;
+    asm volatile (
+        "prfm pstl1strm, %3\n"
+        "1: ldaxr %w0, %3\n"            // owner in [15:0], next in [31:16]
+        "add %w1, %w0, %w5\n"           // take a ticket
+        "stxr %w2, %w1, %3\n"
+        "cbnz %w2, 1b\n"
+        "eor %w1, %w0, %w0, ror #16\n"  // our ticket already being served?
+        "cbz %w1, 3f\n"
+        "sevl\n"
+        "2: wfe\n"
+        "ldaxrh %w2, %4\n"
+        "eor %w1, %w2, %w0, lsr #16\n"
+        "cbnz %w1, 2b\n"
+        "3:\n"
+        : "=&r" (lockval), "=&r" (newval), "=&r" (tmp), "+Q" (*lock)
+        : "Q" (lock->owner), "r" (1 << 16)
+        : "memory"
+    );
+}
+
+static inline int arch_spin_trylock(arch_spinlock_t *lock) {
+    unsigned int lockval, tmp;
+    asm volatile (
+        "prfm pstl1strm, %2\n"
+        "1: ldaxr %w0, %2\n"
+        "eor %w1, %w0, %w0, ror #16\n"  // held: give up
+        "cbnz %w1, 2f\n"
+        "add %w0, %w0, %w3\n"
+        "stxr %w1, %w0, %2\n"
+        "cbnz %w1, 1b\n"
+        "2:\n"
+        : "=&r" (lockval), "=&r" (tmp), "+Q" (*lock)
+        : "r" (1 << 16)
+        : "memory"
+    );
+    return !tmp;
+}
+
+static inline void arch_spin_unlock(arch_spinlock_t *lock) {
+    unsigned short owner = lock->owner + 1;
+    asm volatile (
+        "stlrh %w1, %0\n" // release: also wakes the WFE of the waiters
+        : "=Q" (lock->owner)
+        : "r" (owner)
+        : "memory"
+    );
+}
+
+static inline int arch_spin_is_locked(arch_spinlock_t *lock) {
+    return lock->owner != lock->next;
+}
+
+#ifdef CONFIG_LOCK_STAT
+void lock_stat_acquire(spinlock_t *lock);
+int lock_stat_tryacquire(spinlock_t *lock);
+void lock_stat_release(spinlock_t *lock);
+void print_lock_stats(void);
+#endif
+
+void spin_lock_init(spinlock_t *lock, const char *name);
+
+static inline void spin_lock(spinlock_t *lock) {
+#ifdef CONFIG_LOCK_STAT
+    lock_stat_acquire(lock);
+#else
+    arch_spin_lock(&lock->raw);
+#endif
+}
+
+static inline int spin_trylock(spinlock_t *lock) {
+#ifdef CONFIG_LOCK_STAT
+    return lock_stat_tryacquire(lock);
+#else
+    return arch_spin_trylock(&lock->raw);
+#endif
+}
+
+static inline void spin_unlock(spinlock_t *lock) {
+#ifdef CONFIG_LOCK_STAT
+    lock_stat_release(lock);
+#else
+    arch_spin_unlock(&lock->raw);
+#endif
+}
+
+static inline int spin_is_locked(spinlock_t *lock) {
+    return arch_spin_is_locked(&lock->raw);
+}
+
+/*
+    Mask interrupts on this CPU before taking the lock, so an IRQ handler
+    that needs the same lock can't deadlock against the code it interrupted.
+    flags receives the previous DAIF and is restored on unlock, so these
+    nest correctly.
+*/
+#define spin_lock_irqsave(lock, flags)          \
+    do {                                        \
+        (flags) = disable_interrupt();          \
+        spin_lock(lock);                        \
+    } while (0)
+
+#define spin_unlock_irqrestore(lock, flags)     \
+    do {                                        \
+        spin_unlock(lock);                      \
+        enable_interrupt(flags);                \
+    } while (0)
+
+#endif
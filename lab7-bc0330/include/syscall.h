@@ -5,9 +5,34 @@
 #include "exception_handler.h"
 #include "thread.h"
 
-#define SIGKILL 9
+/*
+    System calls are dispatched through syscall_table[], indexed by the
+    number in x8. Each entry names the handler, how many of x0..x5 it
+    reads and whether it may sleep. Handlers run with interrupts enabled
+    and take locks or mask them only around what an interrupt may touch;
+    see preempt_disable() in thread.h. syscall_handler() counts every call
+    and records its latency from entry to return in a histogram, shown by
+    /dev/syscallstat (any write clears it) and the "syscallstat" command.
+*/
+#define NR_SYSCALLS 43
 
-extern void *signal_handler[10];
+#define SYSCALL_MAY_BLOCK 0x1  // may sleep or switch out, so the latency includes the wait
+
+#define SYSCALLSTAT_BUF_SIZE 8192  // rendered report, truncated beyond this
+
+typedef struct syscall_entry {
+    void (*fn)(trapframe_t *tf);
+    const char *name;
+    unsigned char nargs;
+    unsigned char flags;
+} syscall_entry_t;
+
+extern const syscall_entry_t syscall_table[NR_SYSCALLS];
+
+void syscall_enter(unsigned long nr);
+void syscall_account(unsigned long nr, unsigned long ticks);
+void syscallstat_init(void);
+void print_syscall_stats(void);
 
 void sys_get_pid(trapframe_t *tf);     // 0 
 void sys_uart_read(trapframe_t *tf);   // 1
@@ -32,8 +57,52 @@ void sys_chdir(trapframe_t *tf);       // 17
 void sys_lseek64(trapframe_t *tf);     // 18
 void sys_ioctl(trapframe_t *tf);       // 19
 
+// --- scheduling system calls ---
+void sys_setpriority(trapframe_t *tf); // 20
+void sys_nice(trapframe_t *tf);        // 21
+void sys_nanosleep(trapframe_t *tf);   // 22
+
+// --- process system calls ---
+void sys_waitpid(trapframe_t *tf);     // 23
+
+// --- real-time scheduling ---
+void sys_sched_setscheduler(trapframe_t *tf); // 24
+
+// --- synchronization ---
+void sys_futex(trapframe_t *tf);       // 25
+
+// --- cpu affinity ---
+void sys_sched_setaffinity(trapframe_t *tf); // 26
+void sys_sched_getaffinity(trapframe_t *tf); // 27
+
+// --- batched i/o rings ---
+void sys_ring_setup(trapframe_t *tf);  // 28
+void sys_ring_enter(trapframe_t *tf);  // 29
+
+// --- signals ---
+void sys_sigprocmask(trapframe_t *tf); // 30
+
+// --- vectored and positional i/o ---
+void sys_readv(trapframe_t *tf);       // 31
+void sys_writev(trapframe_t *tf);      // 32
+void sys_pread64(trapframe_t *tf);     // 33
+void sys_pwrite64(trapframe_t *tf);    // 34
+
+// --- time ---
+void sys_clock_gettime(trapframe_t *tf); // 35
+void sys_times(trapframe_t *tf);       // 36
+
+// --- ipc ---
+void sys_pipe(trapframe_t *tf);        // 37
+void sys_shm_open(trapframe_t *tf);    // 38
+void sys_shm_attach(trapframe_t *tf);  // 39
+void sys_shm_detach(trapframe_t *tf);  // 40
+void sys_shm_unlink(trapframe_t *tf);  // 41
+
+// --- i/o multiplexing ---
+void sys_poll(trapframe_t *tf);        // 42
+
 void restore_context(void);
 thread_t *find_thread_by_id(int id);
-void default_sigkill_handler();
 
 #endif
\ No newline at end of file
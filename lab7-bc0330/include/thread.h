@@ -2,12 +2,16 @@
 #define _THREAD_H_
 
 #include <stddef.h>
+#include "rbtree.h"
+#include "smp.h"
+#include "wait.h"
 typedef unsigned long pid_t;
 
-// priority levels
+// priority levels (higher value runs first)
+#define NR_PRIO          64
 #define LOW_PRIORITY     0
-#define MEDIUM_PRIORITY  1
-#define HIGH_PRIORITY    2
+#define MEDIUM_PRIORITY  32
+#define HIGH_PRIORITY    (NR_PRIO - 1)
 
 // Thread status
 #define THREAD_RUNNING   0
@@ -15,7 +19,19 @@ typedef unsigned long pid_t;
 #define THREAD_DEAD      2
 #define THREAD_WAITING   3
 
+// scheduling policies; FIFO and RR threads always run before NORMAL ones
+#define SCHED_NORMAL     0
+#define SCHED_FIFO       1
+#define SCHED_RR         2
+#define RT_PRIO_MIN      1
+#define RT_PRIO_MAX      (NR_PRIO - 1)
+
+// waitpid() options
+#define WNOHANG          1
+
 #define MAX_FD       16
+#define NSIG         32  // signal numbers 1 .. NSIG - 1, see signal.h
+#define SHM_ATTACH_MAX 4 // shared memory segments attached at once, see shm.h
 #define thread_stack_size 0x1000 // Size of the thread stack
 
 typedef struct thread {
@@ -23,6 +39,43 @@ typedef struct thread {
     int priority;               // Thread priority
     int state;                  // Thread states (e.g., running, ready, etc.)
     int exit_code;
+    int killed;                 // thread_kill() pending, acted on before returning to EL0
+    int preempt_count;          // non-zero: an interrupt must not switch it out, see cond_resched()
+    struct thread *pid_next;    // chain in the pid hash table
+
+    // --- real-time scheduling attributes ---
+    int policy;                 // SCHED_NORMAL, SCHED_FIFO or SCHED_RR
+    int rt_priority;            // RT_PRIO_MIN .. RT_PRIO_MAX, 0 for SCHED_NORMAL
+    unsigned long wakeup_stamp; // cntpct of the last wakeup, for latency tracking
+
+    // --- placement, protected by rq_lock ---
+    unsigned long cpus_allowed; // bit n: may run on core n
+    int cpu;                    // core it last ran or was queued on
+
+    // --- scheduler statistics, see schedstat.h ---
+    unsigned long run_ticks;      // time spent on the CPU
+    unsigned long wait_ticks;     // time spent runnable in a run queue
+    unsigned long nr_voluntary;   // switched out because it blocked or exited
+    unsigned long nr_involuntary; // switched out because it was preempted or yielded
+    unsigned long nr_migrations;  // moved to another core
+    unsigned long last_arrival;   // cntpct when it last got the CPU
+    unsigned long last_queued;    // cntpct when it was last queued, 0 if not queued
+    unsigned long user_ticks;     // part of run_ticks spent at EL0
+    unsigned long user_enter;     // cntpct of the last return to EL0
+    unsigned long cutime_ticks;   // user time of reaped children, only changed by waitpid()
+    unsigned long cstime_ticks;   // system time of reaped children, likewise
+
+    // --- process hierarchy, protected by tasklist_lock ---
+    struct thread *parent;      // NULL for kernel threads and orphans
+    struct thread *children;    // first child, linked through sibling
+    struct thread *sibling;
+    wait_queue_head_t wait_child; // waitpid() sleeps here until a child exits
+
+    // --- fair scheduling attributes ---
+    unsigned long vruntime;     // weighted run time in counter ticks
+    unsigned long exec_start;   // cntpct when the thread last started running
+    unsigned long slice_start;  // cntpct when the current timeslice began
+    rb_node_t run_node;         // node in the fair run queue tree
 
     void *usr_stack;            // Pointer to the thread's stack
     void *usr_stack_base;       // Base of the thread's stack
@@ -52,15 +105,19 @@ typedef struct thread {
           12: sp
         */
 
-    // --- signal handling attributes ---
-    unsigned int signal; 
-    unsigned long signal_context[13];
-    void *signal_stack_base;
-    void *signal_kernel_stack_base;
+    struct fpsimd_state *fpsimd; // saved V registers, NULL until EL0 first uses FP/SIMD
+    struct uring *ring;         // rings it owns, or polls as their SQPOLL thread; see uring.h
+    struct shm_segment *shm[SHM_ATTACH_MAX]; // attached segments, slot i at SHM_USER_BASE + i * SHM_MAX_SIZE
+
+    // --- signal handling attributes, see signal.h ---
+    unsigned long sig_pending;  // bit n: signal n was sent, protected by sig_lock
+    unsigned long sig_blocked;  // bit n: signal n is held back, protected by sig_lock
+    void *sig_handlers[NSIG];     // SIG_DFL, SIG_IGN or a user function, per signal
 
     // --- vfs attributes ---
     struct vnode *cwd;  // Current working directory
     struct file  *files_table[MAX_FD]; // File descriptors table
+    spinlock_t files_lock;      // files_table slots, see fd_install()
 
     struct thread* prev;
     struct thread* next;        // Pointer to the next thread in the queue
@@ -71,29 +128,111 @@ typedef struct thread_queue {
     thread_t* tail; // Pointer to the tail of the queue
 } thread_queue_t;
 
-extern thread_queue_t run_queue[3];   // Global run queue
+/*
+    O(1) priority array: one round-robin list per priority level plus a
+    bitmap of non-empty levels, so the highest ready level is found with
+    a single CLZ no matter how many threads are runnable.
+*/
+typedef struct prio_array {
+    unsigned long bitmap;            // bit i set <=> queue[i] is not empty
+    unsigned int nr_running;         // number of queued threads
+    thread_queue_t queue[NR_PRIO];   // per-level round-robin lists
+} prio_array_t;
+
+/*
+    Fair run queue: runnable threads ordered by virtual runtime; the
+    leftmost node (smallest vruntime) runs next.
+*/
+typedef struct cfs_rq {
+    rb_root_t tasks;                 // threads keyed on vruntime
+    rb_node_t *leftmost;             // cached smallest vruntime
+    unsigned long min_vruntime;      // monotonic floor for new/woken threads
+    unsigned long load;              // sum of queued weights
+    unsigned int nr_running;         // number of queued threads
+} cfs_rq_t;
+
+/*
+    Scheduling class: the policy behind thread_enqueue()/thread_dequeue().
+    Selected once at boot, before the first thread is queued.
+*/
+struct sched_class {
+    const char *name;
+    void (*enqueue)(thread_t *t);
+    thread_t *(*pick_next)(void);
+    void (*remove)(thread_t *t);
+    int (*tick)(thread_t *curr);     // non-zero: preempt curr
+    unsigned long (*slice_end)(thread_t *curr); // cntpct when curr's slice ends
+    unsigned int (*nr_running)(void);           // queued threads, excluding curr
+    void (*print)(void);
+};
+
+extern prio_array_t run_queue;        // Global run queue
+extern cfs_rq_t cfs_run_queue;        // Global fair run queue
+extern prio_array_t rt_run_queue;     // SCHED_FIFO/SCHED_RR threads, keyed on rt_priority
+extern const struct sched_class rr_sched_class;
+extern const struct sched_class fair_sched_class;
+extern const struct sched_class rt_sched_class;
+extern const struct sched_class *sched_class; // active scheduling class
 extern thread_queue_t zombies_queue;  // Global zombies queue
 extern thread_t *current_thread;      // Pointer to the currently running thread
-extern unsigned long counter;         // counter for thread ID
+extern thread_t *idle_threads[NR_CPUS]; // Fallback when the run queue is empty
+#define idle_thread (idle_threads[smp_processor_id()])
+extern spinlock_t tasklist_lock;      // protects parent/children/sibling links
+extern int need_resched;              // a woken thread should preempt the running one
+extern unsigned long rt_max_wakeup_latency; // worst wakeup-to-run delay of an RT thread, in ticks
+
+/*
+    System calls run with interrupts enabled but are not preempted by
+    them: the interrupt only sets need_resched, and the switch happens on
+    the way back to EL0 or at a cond_resched() in a long loop. Only
+    threads with a zero count, like idle, are switched out from irq_handler().
+*/
+static inline void preempt_disable(void) {
+    current_thread->preempt_count++;
+    asm volatile ("" : : : "memory");
+}
+
+static inline void preempt_enable(void) {
+    asm volatile ("" : : : "memory");
+    current_thread->preempt_count--;
+}
 
 extern void switch_to(void *prev, void *next, void *next_pgd);
 extern void *get_current(void);
 
+void sched_init(const char *bootargs);
 void init_thread(void);
+void init_idle(void);
+thread_t *thread_alloc(void);
+void thread_free(thread_t *thread);
 thread_t *thread_create(void (*function)(void), int priority, void (*user_prog)(void), size_t prog_size);
 void schedule(void);
+void cond_resched(void);
+void schedule_tail(void);
+void sched_tick(void);
+unsigned long sched_slice_end(void);
+unsigned int sched_nr_running(void);
 void foo(void);
 void idle(void);
+void cpu_do_idle(void);
 void kill_zombies(void);
 
 
 void thread_start(void);
 void thread_kill(thread_t *t, int status);
 void thread_exit(void);
+void do_exit(int status);
+void thread_check_killed(void);
+void exit_to_user(struct trapframe *tf);
+long thread_waitpid(long pid, int *status, int options);
 
 void thread_enqueue(thread_t *t);
 thread_t *thread_dequeue();
 void thread_remove_from_queue(thread_t *t);
+int thread_wakeup(thread_t *t);
+int thread_set_priority(thread_t *t, int priority);
+int thread_setscheduler(thread_t *t, int policy, int rt_priority);
+int thread_set_affinity(thread_t *t, unsigned long mask);
 
 void print_thread_info();
 
@@ -0,0 +1,91 @@
+#ifndef __TIMER_H__
+#define __TIMER_H__
+
+// --- ARM generic timer helpers ---
+static inline unsigned long read_cntpct(void) {
+    unsigned long cnt;
+    asm volatile ("isb\n" "mrs %0, cntpct_el0\n" : "=r" (cnt));
+    return cnt;
+}
+
+static inline unsigned long read_cntfrq(void) {
+    unsigned long frq;
+    asm volatile ("mrs %0, cntfrq_el0\n" : "=r" (frq));
+    return frq;
+}
+
+// convert between counter ticks and microseconds
+static inline unsigned long us_to_ticks(unsigned long us) {
+    return us * read_cntfrq() / 1000000;
+}
+
+// whole seconds and the remainder apart, so long intervals don't overflow
+static inline unsigned long ticks_to_us(unsigned long ticks) {
+    unsigned long frq = read_cntfrq();
+    return (ticks / frq) * 1000000 + (ticks % frq) * 1000000 / frq;
+}
+
+static inline unsigned long ticks_to_ns(unsigned long ticks) {
+    unsigned long frq = read_cntfrq();
+    return (ticks / frq) * 1000000000 + (ticks % frq) * 1000000000 / frq;
+}
+
+#define TIMER_NO_EVENT (~0UL)
+#define MAX_TIMERS     256
+
+/*
+    A timer event is owned by the caller (often on its stack or inside a
+    thread_t); the subsystem only keeps pointers to pending ones in a
+    min-heap ordered by expiry, multiplexed onto the single CNTP timer.
+    Callbacks run from the timer softirq with interrupts enabled, so they
+    must not sleep and must take their locks with spin_lock_irqsave().
+*/
+typedef struct timer_event {
+    unsigned long expires;          // absolute cntpct
+    void (*callback)(void *data);
+    void *data;
+    int index;                      // heap slot, -1 when not pending
+} timer_event_t;
+
+struct timespec {
+    long tv_sec;
+    long tv_nsec;
+};
+
+// clock_gettime() clocks; there is no RTC, so the real-time clock counts from boot too
+#define CLOCK_REALTIME  0
+#define CLOCK_MONOTONIC 1
+
+#define CLK_TCK 100 // unit of times(), in ticks per second
+
+struct tms {
+    long tms_utime;  // user time of the process
+    long tms_stime;  // system time of the process
+    long tms_cutime; // user time of its reaped children
+    long tms_cstime; // system time of its reaped children
+};
+
+static inline unsigned long ticks_to_clock_t(unsigned long ticks) {
+    return ticks / (read_cntfrq() / CLK_TCK);
+}
+
+extern int tick_stopped;   // no timer interrupt is pending
+
+void init_timers(void);
+void init_timer(timer_event_t *timer, void (*callback)(void *data), void *data);
+int add_timer(timer_event_t *timer);
+int del_timer(timer_event_t *timer);
+int mod_timer(timer_event_t *timer, unsigned long expires);
+static inline int timer_pending(const timer_event_t *timer) {
+    return timer->index >= 0;
+}
+void run_timers(void);
+unsigned long timer_next_expiry(void);
+
+unsigned long schedule_timeout(unsigned long timeout);
+
+void timer_program(unsigned long deadline);
+void timer_stop(void);
+void tick_program_next(void);
+
+#endif
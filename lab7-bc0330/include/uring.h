@@ -0,0 +1,87 @@
+#ifndef __URING_H__
+#define __URING_H__
+
+#include <stddef.h>
+#include "thread.h"
+#include "wait.h"
+
+/*
+    Submission/completion rings for batched I/O. ring_setup() maps one
+    shared page at URING_USER_BASE; user space fills submission entries,
+    bumps sq_tail and calls ring_enter() once for the whole batch, then
+    reaps the completions between cq_head and cq_tail. With
+    URING_SETUP_SQPOLL a kernel thread polls the submission ring, so a
+    busy program doesn't enter the kernel at all; the thread sleeps after
+    idle_us without work and sets URING_SQ_NEED_WAKEUP in sq_flags, and
+    ring_enter(URING_ENTER_SQ_WAKEUP) starts it again.
+
+    The indices run freely and are masked with entries - 1. Each side only
+    writes its own index: user space sq_tail and cq_head, the kernel
+    sq_head and cq_tail. Entries are not consumed while the completion
+    ring is full, so completions are never dropped.
+*/
+#define URING_USER_BASE 0x100000000UL // user address of the shared page
+#define URING_ENTRIES   64            // maximum ring size, a power of two
+#define URING_SQPOLL_IDLE_US 10000    // default poller idle time
+
+// opcodes; res is what the matching system call would return
+#define URING_OP_NOP   0
+#define URING_OP_READ  1              // fd, addr: buffer, len: byte count
+#define URING_OP_WRITE 2              // fd, addr: buffer, len: byte count
+#define URING_OP_OPEN  3              // addr: path, len: open flags
+#define URING_OP_CLOSE 4              // fd
+
+// ring_setup() flags
+#define URING_SETUP_SQPOLL    1
+
+// ring_enter() flags
+#define URING_ENTER_GETEVENTS 1       // wait for min_complete completions
+#define URING_ENTER_SQ_WAKEUP 2       // restart an idle poller
+
+// sq_flags
+#define URING_SQ_NEED_WAKEUP  1
+
+struct uring_sqe {
+    unsigned int opcode;
+    int fd;
+    unsigned long addr;
+    unsigned long len;
+    unsigned long user_data;    // copied to the completion
+};
+
+struct uring_cqe {
+    unsigned long user_data;
+    long res;
+};
+
+struct uring_page {
+    volatile unsigned int sq_head;  // written by the kernel
+    volatile unsigned int sq_tail;  // written by user space
+    volatile unsigned int cq_head;  // written by user space
+    volatile unsigned int cq_tail;  // written by the kernel
+    volatile unsigned int sq_flags;
+    unsigned int entries;
+    struct uring_sqe sqes[URING_ENTRIES];
+    struct uring_cqe cqes[URING_ENTRIES];
+};
+
+typedef struct uring {
+    struct uring_page *page;    // kernel address of the shared page
+    thread_t *owner;
+    unsigned int entries;       // kernel copies, user space may scribble on the page
+    unsigned int sq_head;
+    unsigned int cq_tail;
+
+    // --- SQPOLL ---
+    thread_t *poller;           // NULL without SQPOLL or once it exited
+    unsigned long idle_ticks;   // poll this long without work before sleeping
+    int stop;                   // uring_release(): the poller must exit
+    wait_queue_head_t sq_wait;  // idle poller
+    wait_queue_head_t cq_wait;  // ring_enter() waiting for completions, uring_release() for the poller
+} uring_t;
+
+long uring_setup(unsigned int entries, unsigned int flags, unsigned long idle_us);
+long uring_enter(unsigned int to_submit, unsigned int min_complete, unsigned int flags);
+void uring_release(thread_t *t);
+
+#endif
@@ -23,6 +23,20 @@
 #define S_IFIFO  0010000  // FIFO
 #define S_IFLNK  0120000  // symbolic link
 #define S_IFSOCK 0140000  // socket
+// lseek64() whence
+#define SEEK_SET 0
+#define SEEK_CUR 1
+#define SEEK_END 2
+
+#define UIO_MAXIOV 16     // buffers per readv()/writev() call
+
+struct iovec {
+  void *iov_base;
+  size_t iov_len;
+};
+
+struct poll_table;
+struct thread;
 
 struct vnode {
   struct mount* mount;
@@ -47,6 +61,7 @@ struct file {
   size_t f_pos;  // RW position of this file handle
   struct file_operations* f_ops;
   int flags;
+  int ref;       // file descriptors sharing this handle, see vfs_dup()
 };
 
 struct mount {
@@ -70,7 +85,16 @@ struct file_operations {
   int (*read)(struct file* file, void* buf, size_t len);
   int (*open)(struct vnode* file_node, struct file** target);
   int (*close)(struct file* file);
-  long (*lseek64)(struct file* file, long offset, int whence);
+  long (*lseek64)(struct file* file, long offset, int whence); // -1: not seekable
+  // optional; without them vfs_pread()/vfs_pwrite() seek around read/write
+  // and vfs_readv()/vfs_writev() call read/write once per buffer
+  int (*pread)(struct file* file, void* buf, size_t len, size_t pos);
+  int (*pwrite)(struct file* file, const void* buf, size_t len, size_t pos);
+  long (*readv)(struct file* file, const struct iovec* iov, int iovcnt);
+  long (*writev)(struct file* file, const struct iovec* iov, int iovcnt);
+  // optional: ready events (POLLIN, POLLOUT, ...), queueing on its wait
+  // queue with poll_wait(); without it the file is always ready, see poll.h
+  unsigned int (*poll)(struct file* file, struct poll_table* pt);
 };
 
 struct vnode_operations {
@@ -92,8 +116,26 @@ struct filesystem* find_filesystem(const char* name);
 // file operations
 int vfs_open(const char* pathname, int flags, struct file** target);
 int vfs_close(struct file* file);
+struct file* vfs_dup(struct file* file);
 int vfs_write(struct file* file, const void* buf, size_t len);
 int vfs_read(struct file* file, void* buf, size_t len);
+long vfs_lseek64(struct file* file, long offset, int whence);
+int vfs_pread(struct file* file, void* buf, size_t len, size_t pos);
+int vfs_pwrite(struct file* file, const void* buf, size_t len, size_t pos);
+long vfs_readv(struct file* file, const struct iovec* iov, int iovcnt);
+long vfs_writev(struct file* file, const struct iovec* iov, int iovcnt);
+unsigned int vfs_poll(struct file* file, struct poll_table* pt);
+long generic_file_lseek(struct file* file, long offset, int whence, size_t size, size_t max);
+
+/*
+    File descriptor tables. A ring's SQPOLL thread works on its owner's
+    table, so slots change under t->files_lock, and a file looked up by fd
+    is used through a reference of its own: a close() meanwhile only
+    drops the table's one.
+*/
+int fd_install(struct thread* t, struct file* file);
+struct file* fd_get(struct thread* t, int fd);
+struct file* fd_remove(struct thread* t, int fd);
 
 // file system operations
 int vfs_mkdir(const char* pathname);
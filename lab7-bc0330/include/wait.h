@@ -0,0 +1,88 @@
+#ifndef __WAIT_H__
+#define __WAIT_H__
+
+#include <stddef.h>
+#include "spinlock.h"
+
+/*
+    Wait queue: threads sleeping until some condition becomes true. The
+    waker changes the condition and calls wake_up(); sleepers re-check the
+    condition after every wakeup, so spurious wakeups are harmless.
+
+    The types come before thread.h is included, since thread_t embeds a
+    wait queue head.
+*/
+typedef struct wait_queue_entry {
+    struct thread *task;
+    struct wait_queue_entry *prev;
+    struct wait_queue_entry *next;
+    int queued;
+} wait_queue_entry_t;
+
+typedef struct wait_queue_head {
+    spinlock_t lock;
+    wait_queue_entry_t *head;
+    wait_queue_entry_t *tail;
+} wait_queue_head_t;
+
+#include "exception_handler.h"
+#include "thread.h"
+#include "timer.h"
+
+void init_waitqueue_head(wait_queue_head_t *wq);
+void init_wait_entry(wait_queue_entry_t *entry);
+void add_wait_queue(wait_queue_head_t *wq, wait_queue_entry_t *entry);
+void remove_wait_queue(wait_queue_head_t *wq, wait_queue_entry_t *entry);
+void prepare_to_wait(wait_queue_head_t *wq, wait_queue_entry_t *entry);
+void finish_wait(wait_queue_head_t *wq, wait_queue_entry_t *entry);
+void wake_up(wait_queue_head_t *wq);
+
+/*
+    Sleep until condition is true. Interrupts are masked between the
+    check and schedule(), so a wake_up() from an IRQ handler can't be lost.
+*/
+#define wait_event(wq, condition)                                   \
+    do {                                                            \
+        wait_queue_entry_t __wait;                                  \
+        init_wait_entry(&__wait);                                   \
+        unsigned long __daif = disable_interrupt();                 \
+        while (1) {                                                 \
+            prepare_to_wait(&(wq), &__wait);                        \
+            if (condition) {                                        \
+                break;                                              \
+            }                                                       \
+            schedule();                                             \
+        }                                                           \
+        finish_wait(&(wq), &__wait);                                \
+        enable_interrupt(__daif);                                   \
+    } while (0)
+
+/*
+    Like wait_event() but gives up after timeout counter ticks. Evaluates
+    to 0 on timeout, otherwise to the ticks left (at least 1).
+*/
+#define wait_event_timeout(wq, condition, timeout)                  \
+    ({                                                              \
+        unsigned long __left = (timeout);                           \
+        wait_queue_entry_t __wait;                                  \
+        init_wait_entry(&__wait);                                   \
+        unsigned long __daif = disable_interrupt();                 \
+        while (1) {                                                 \
+            prepare_to_wait(&(wq), &__wait);                        \
+            if (condition) {                                        \
+                if (__left == 0) {                                  \
+                    __left = 1;                                     \
+                }                                                   \
+                break;                                              \
+            }                                                       \
+            if (__left == 0) {                                      \
+                break;                                              \
+            }                                                       \
+            __left = schedule_timeout(__left);                      \
+        }                                                           \
+        finish_wait(&(wq), &__wait);                                \
+        enable_interrupt(__daif);                                   \
+        __left;                                                     \
+    })
+
+#endif
@@ -0,0 +1,33 @@
+#ifndef __WORKQUEUE_H__
+#define __WORKQUEUE_H__
+
+#include <stddef.h>
+
+/*
+    Deferred work in process context. queue_work() may be called from
+    interrupt and softirq context; the work function later runs in the
+    queue's worker kernel thread, where it may sleep and take its time. A
+    work item that is queued again before it runs still runs once.
+
+    system_wq's worker runs at MEDIUM_PRIORITY. Housekeeping that should
+    stay out of normal threads' way, like reaping, goes to
+    system_lowpri_wq, whose worker runs at LOW_PRIORITY.
+*/
+struct workqueue_struct;
+extern struct workqueue_struct *system_wq;
+extern struct workqueue_struct *system_lowpri_wq;
+
+struct work_struct {
+    struct work_struct *next;
+    int pending;                              // queued, not yet running
+    void (*func)(struct work_struct *work);
+};
+
+#define DECLARE_WORK(name, fn) \
+    struct work_struct name = { NULL, 0, fn }
+
+void init_workqueue(void);
+void init_work(struct work_struct *work, void (*func)(struct work_struct *work));
+int queue_work(struct workqueue_struct *wq, struct work_struct *work);
+
+#endif
@@ -2,11 +2,13 @@
 #include <stddef.h>
 #include "devicetree.h"
 #include "mini_uart.h"
+#include "spinlock.h"
 #include "utils.h"
 
 page_info_t *alloc_array; // page info array
 int free_list[MAX_ORDER + 1] = {-1};
 unsigned long chunk_list[MAX_CHUNK_ORDER - MIN_CHUNK_ORDER + 1] = {0}; // free chunk list for order 4 to 8
+static DEFINE_SPINLOCK(alloc_lock); // protects free_list, chunk_list and alloc_array
 extern char *__start_code;
 extern char *__end_code;
 
@@ -81,15 +83,20 @@ void *allocate(size_t size) {
         uart_send_string(" bytes\n");
         return nullptr;
     }
+    void *addr;
+    unsigned long flags;
+    spin_lock_irqsave(&alloc_lock, flags);
     if (size > power(2, MAX_CHUNK_ORDER)) {
         int page_num = size / PAGE_SIZE;
         if (size % PAGE_SIZE != 0) {
             page_num++;
         }
-        return page_alloc(page_num);
+        addr = page_alloc(page_num);
     } else {
-        return chunck_alloc(size);
+        addr = chunck_alloc(size);
     }
+    spin_unlock_irqrestore(&alloc_lock, flags);
+    return addr;
 }
 
 void free(void *addr) {
@@ -98,6 +105,8 @@ void free(void *addr) {
         return;
     }
     unsigned long index = ((unsigned long) addr - ALLOC_BASE) / PAGE_SIZE;
+    unsigned long flags;
+    spin_lock_irqsave(&alloc_lock, flags);
     int status = alloc_array[index].status;
     if (status == allocated) {
         free_page(addr);
@@ -107,6 +116,7 @@ void free(void *addr) {
     } else {
         uart_send_string("Free Error: memory not allocated\n");
     }
+    spin_unlock_irqrestore(&alloc_lock, flags);
 }
 
 void *page_alloc(size_t num_pages) {
@@ -0,0 +1,119 @@
+#include <stddef.h>
+#include "allocator.h"
+#include "bench.h"
+#include "mini_uart.h"
+#include "spinlock.h"
+#include "thread.h"
+#include "timer.h"
+#include "user_prog.h"
+#include "utils.h"
+#include "wait.h"
+
+#ifdef CONFIG_BENCH
+/*
+    Spawn rate benchmark, built with BENCH=1 and started from kernel_main():
+    kernel thread create+run+exit, then fork+exit+waitpid from EL0, then
+    the wakeup latency of a SCHED_FIFO thread.
+*/
+extern char bench_fork_prog[];
+extern char bench_fork_prog_end[];
+
+static int bench_done;
+static wait_queue_head_t bench_wait;
+static DEFINE_SPINLOCK(bench_lock);
+
+static void bench_noop(void) {
+    unsigned long flags;
+    spin_lock_irqsave(&bench_lock, flags);
+    bench_done++;
+    spin_unlock_irqrestore(&bench_lock, flags);
+    wake_up(&bench_wait);
+}
+
+static void print_rate(const char *what, unsigned long n, unsigned long ticks) {
+    uart_send_string((char *)what);
+    uart_send_num(n * read_cntfrq() / ticks, "dec");
+    uart_send_string("/sec (");
+    uart_send_num(n, "dec");
+    uart_send_string(" in ");
+    uart_send_num(ticks_to_us(ticks), "dec");
+    uart_send_string(" us)\r\n");
+}
+
+static void bench_threads(void) {
+    int created = 0;
+    bench_done = 0;
+    unsigned long start = read_cntpct();
+    for (int i = 0; i < BENCH_THREADS; i += BENCH_BATCH) {
+        for (int j = 0; j < BENCH_BATCH; ++j) {
+            if (thread_create(bench_noop, MEDIUM_PRIORITY, NULL, 0) != NULL) {
+                created++;
+            }
+        }
+        wait_event(bench_wait, bench_done == created);
+    }
+    print_rate("[BENCH] threads: ", created, read_cntpct() - start);
+}
+
+static void bench_fork(void) {
+    size_t size = bench_fork_prog_end - bench_fork_prog;
+    void *prog = allocate(size); // freed with the thread
+    memcpy(prog, bench_fork_prog, size);
+
+    unsigned long start = read_cntpct();
+    thread_t *t = thread_create(dummy_prog, MEDIUM_PRIORITY, prog, size);
+    if (t == NULL) {
+        uart_send_string("[ERROR | BENCH] Failed to create the fork thread\r\n");
+        return;
+    }
+    // adopt it so we can wait for it; it can't run before we sleep
+    unsigned long flags;
+    spin_lock_irqsave(&tasklist_lock, flags);
+    t->parent = current_thread;
+    t->sibling = current_thread->children;
+    current_thread->children = t;
+    spin_unlock_irqrestore(&tasklist_lock, flags);
+    thread_waitpid(t->id, NULL, 0);
+    print_rate("[BENCH] fork+exit: ", BENCH_FORKS, read_cntpct() - start);
+}
+
+/*
+    cyclictest: sleep on a timer as a SCHED_FIFO thread and measure how
+    late we run compared to the expiry.
+*/
+static void bench_rt_latency(void) {
+    unsigned long interval = us_to_ticks(BENCH_RT_INTERVAL_US);
+    unsigned long max = 0;
+    unsigned long total = 0;
+    if (thread_setscheduler(current_thread, SCHED_FIFO, RT_PRIO_MAX / 2) != 0) {
+        uart_send_string("[ERROR | BENCH] Failed to switch to SCHED_FIFO\r\n");
+        return;
+    }
+    for (int i = 0; i < BENCH_RT_LOOPS; ++i) {
+        unsigned long expires = read_cntpct() + interval;
+        current_thread->state = THREAD_WAITING;
+        schedule_timeout(interval);
+        unsigned long late = read_cntpct() - expires;
+        total += late;
+        if (late > max) {
+            max = late;
+        }
+    }
+    thread_setscheduler(current_thread, SCHED_NORMAL, 0);
+
+    uart_send_string("[BENCH] rt latency (us): max ");
+    uart_send_num(ticks_to_us(max), "dec");
+    uart_send_string(" avg ");
+    uart_send_num(ticks_to_us(total / BENCH_RT_LOOPS), "dec");
+    uart_send_string(" wakeup-to-run max ");
+    uart_send_num(ticks_to_us(rt_max_wakeup_latency), "dec");
+    uart_send_string("\r\n");
+}
+
+void bench_main(void) {
+    init_waitqueue_head(&bench_wait);
+    bench_threads();
+    bench_fork();
+    bench_rt_latency();
+}
+#endif
@@ -30,7 +30,10 @@ struct vnode_operations devfs_vops = {
     .mkdir = mkdir,
 };
 
+static struct vnode *devfs_root = NULL; // /dev, where devfs_register() adds devices
+
 static int setup_mount(struct filesystem* fs, struct mount* mount) {
+    devfs_root = mount->root;
     mount->fs = fs;
     mount->root->mount = mount;
     mount->root->v_ops = &devfs_vops;
@@ -80,7 +83,8 @@ static int close(struct file* file) {
 }
 
 static long lseek64(struct file* file, long offset, int whence) {
-    return 0; // Seek successful
+    devfs_internal_t* inter = (devfs_internal_t*)file->vnode->internal;
+    return generic_file_lseek(file, offset, whence, inter->size, MAX_FILE_SIZE);
 }
 
 static int lookup(struct vnode* dir_node, struct vnode** target,
@@ -153,4 +157,60 @@ struct filesystem* devfs_create(void) {
     fs->name = "devfs";
     fs->setup_mount = &setup_mount;
     return fs;
-}
\ No newline at end of file
+}
+
+/*
+    Add a character device to /dev whose reads and writes go to fops. The
+    node belongs to devfs, so lookup from the directory works as usual.
+*/
+// data ends up in the device's devfs_internal_t content, for its file operations
+int devfs_register_data(const char *name, struct file_operations *fops, void *data) {
+    struct vnode *node = NULL;
+    if (devfs_root == NULL) {
+        uart_send_string("[ERROR | Register] devfs is not mounted\r\n");
+        return -1;
+    }
+    if (lookup(devfs_root, &node, name) == 0) {
+        uart_send_string("[ERROR | Register] Device already exists\r\n");
+        return -1;
+    }
+
+    devfs_internal_t* dir_inter = (devfs_internal_t*)devfs_root->internal;
+    int i;
+    for (i = 0; i < DIR_ENTRIES; ++i) {
+        if (dir_inter->dir_entries[i].vnode == NULL) {
+            break;
+        }
+    }
+    if (i == DIR_ENTRIES) {
+        uart_send_string("[ERROR | Register] Directory entry full\r\n");
+        return -1;
+    }
+
+    node = allocate(sizeof(struct vnode));
+    node->mount = NULL;
+    node->v_ops = &devfs_vops;
+    node->f_ops = fops;
+    node->parent = devfs_root;
+    node->internal = allocate(sizeof(devfs_internal_t));
+
+    devfs_internal_t* inter = (devfs_internal_t*)node->internal;
+    inter->mode = S_IFCHR;
+    inter->size = 0;
+    inter->content = data;
+    inter->child_count = 0;
+    for (int j = 0; j < DIR_ENTRIES; ++j) {
+        inter->dir_entries[j].vnode = NULL;
+        inter->dir_entries[j].name[0] = '\0';
+    }
+    strcpy(inter->name, name);
+
+    dir_inter->dir_entries[i].vnode = node;
+    strcpy(dir_inter->dir_entries[i].name, name);
+    dir_inter->child_count++;
+    return 0;
+}
+
+int devfs_register(const char *name, struct file_operations *fops) {
+    return devfs_register_data(name, fops, NULL);
+}
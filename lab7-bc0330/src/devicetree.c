@@ -69,6 +69,40 @@ void fdt_traverse(void (*callback)(char *)) {
     }
 }
 
+void *fdt_get_property(const char *name) {
+    struct fdt_header *fdt = (struct fdt_header *) __dtb_addr;
+    if (be2le(fdt->magic) != 0xd00dfeed) {
+        return NULL;
+    }
+
+    uint32_t struct_size = be2le(fdt->size_dt_struct);
+    char *struct_addr = (char *) fdt + be2le(fdt->off_dt_struct);
+    uint32_t struct_off = 0;
+    char *strings_addr = (char *) fdt + be2le(fdt->off_dt_strings);
+
+    while (struct_off < struct_size) {
+        uint32_t token = be2le(*(uint32_t *) (struct_addr + struct_off));
+        struct_off += 4;
+
+        if (token == FDT_BEGIN_NODE) {
+            struct_off += (strlen(struct_addr + struct_off) + 1 + 3) & ~3;  // skip the node name
+        } else if (token == FDT_PROP) {
+            uint32_t len = be2le(*(uint32_t *) (struct_addr + struct_off));
+            uint32_t nameoff = be2le(*(uint32_t *) (struct_addr + struct_off + 4));
+            struct_off += 8;
+            if (strcmp(strings_addr + nameoff, name) == 1) {
+                return struct_addr + struct_off; // first property with that name
+            }
+            struct_off += (len + 3) & ~3;
+        } else if (token == FDT_END) {
+            break;
+        } else if (token != FDT_END_NODE && token != FDT_NOP) {
+            break; // malformed structure block
+        }
+    }
+    return NULL;
+}
+
 void initramfs_callback(char *prop_addr) {
     rootfs_addr = (char *)ptov(be2le(*(uint64_t *) prop_addr));
     uart_send_string("Found initramfs at ");
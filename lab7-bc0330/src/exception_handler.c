@@ -1,22 +1,33 @@
 #include "allocator.h"
 #include "exception_handler.h"
+#include "fpsimd.h"
 #include "mailbox.h"
 #include "mini_uart.h"
 #include "rootfs.h"
+#include "schedstat.h"
+#include "softirq.h"
 #include "syscall.h"
-// #include "thread.h"
+#include "thread.h"
+#include "timer.h"
 #include "utils.h"
+#include "wait.h"
 
 char read_buffer[MAX_BUFFER_SIZE] = {'\0'};
 char write_buffer[MAX_BUFFER_SIZE]  = {'\0'};
-int read_front = 0;
-int read_rear = 0;
-int write_front = 0;
-int write_rear = 0;
+volatile int read_front = 0;
+volatile int read_rear = 0;
+volatile int write_front = 0;
+volatile int write_rear = 0;
+wait_queue_head_t uart_read_wait;
+
+static void uart_rx_action(unsigned long data) {
+    wake_up(&uart_read_wait);
+}
+static DECLARE_TASKLET(uart_rx_tasklet, uart_rx_action, 0);
 
 void enable_interrupt(unsigned long daif) {
     asm volatile (
-        "msr DAIF, x0\n" // enable IRQ
+        "msr DAIF, %0\n" // restore the saved mask
         : /* no output */
         : "r" (daif)
     );
@@ -37,6 +48,9 @@ unsigned long disable_interrupt(void) {
 void sync_handler(trapframe_t *tf) {
     unsigned long daif = disable_interrupt();
     // uart_send_string("Sync handler called\r\n");
+    if ((tf->spsr_el1 & 0xf) == 0) {
+        acct_enter_kernel(current_thread);
+    }
     
     unsigned long esr;
     asm volatile (
@@ -48,6 +62,9 @@ void sync_handler(trapframe_t *tf) {
         case 0b010101:  // SVC
             syscall_handler(tf);
             break;
+        case 0b000111:  // FP/SIMD access trapped by CPACR_EL1
+            do_fpsimd_acc();
+            break;
         case 0b100100:  // data abort
             // uart_send_string("Data abort\r\n");
             break;
@@ -61,6 +78,10 @@ void sync_handler(trapframe_t *tf) {
             // while (1);
             break;
     }
+    if ((tf->spsr_el1 & 0xf) == 0) {
+        exit_to_user(tf); // back to EL0: act on a pending preemption, kill or signal
+        acct_return_to_user(current_thread);
+    }
     enable_interrupt(daif);
 }
 
@@ -70,195 +91,93 @@ void syscall_handler(trapframe_t *tf) {
 
     unsigned long syscall_num = sp->x[8]; // syscall number
 
-    // handle_signal();
-
-    switch (syscall_num) {
-        case 0:   // getpid
-            sys_get_pid((trapframe_t *)sp);
-            break;
-        case 1: { // read
-            enable_interrupt(0x0);
-            sys_uart_read((trapframe_t *)sp);
-            disable_interrupt();
-            break;
-        }
-        case 2: { // write
-            enable_interrupt(0x0);
-            sys_uart_write((trapframe_t *)sp);
-            disable_interrupt();
-            break;
-        }
-        case 3: { // exec
-            sys_exec((trapframe_t *)sp);
-            break;
-        }
-        case 4: {        // fork
-            sys_fork((trapframe_t *)sp);
-            break;
-        }
-        case 5: {        // exit
-            sys_exit((trapframe_t *)sp);
-            break;
-        }
-        case 6: {        // mbox call
-            sys_mbox_call((trapframe_t *)sp);
-            break;
-        }
-        case 7: {        
-            sys_kill((trapframe_t *)sp);
-            break;
-        }
-        case 8: {
-            sys_signal((trapframe_t *)sp);
-            break;
-        }
-        case 9: {
-            sys_sigkill((trapframe_t *)sp);
-            break;
-        }
-        case 10: {       // get time
-            sys_sigreturn((trapframe_t *)sp);
-            break;
-        }
-        case 11: {       // open
-            sys_open((trapframe_t *)sp);
-            break;
-        }
-        case 12: {       // close
-            sys_close((trapframe_t *)sp);
-            break;
-        }
-        case 13: {       // write
-            sys_write((trapframe_t *)sp);
-            break;
-        }
-        case 14: {       // read
-            sys_read((trapframe_t *)sp);
-            break;
-        }
-        case 15: {       // mkdir
-            sys_mkdir((trapframe_t *)sp);
-            break;
-        }
-        case 16: {       // mount
-            sys_mount((trapframe_t *)sp);
-            break;
-        }
-        case 17: {       // chdir
-            sys_chdir((trapframe_t *)sp);
-            break;
-        }
-        case 18: {
-            sys_lseek64((trapframe_t *)sp);
-            break;
-        }
-        case 19: {
-            sys_ioctl((trapframe_t *)sp);
-            break;
-        }
-        default:
-            uart_send_string("Unknown syscall\r\n");
-            uart_send_num(syscall_num, "dec");
-            uart_send_string("\r\n");
-            sp->x[0] = -1; // return -1
-            break;
+    if (syscall_num >= NR_SYSCALLS || syscall_table[syscall_num].fn == NULL) {
+        uart_send_string("Unknown syscall\r\n");
+        uart_send_num(syscall_num, "dec");
+        uart_send_string("\r\n");
+        sp->x[0] = -1; // return -1
+        return;
     }
+    const syscall_entry_t *entry = &syscall_table[syscall_num];
+    syscall_enter(syscall_num);
+    unsigned long start = read_cntpct();
+    preempt_disable(); // interrupts are served meanwhile, a switch waits for cond_resched() or EL0
+    enable_interrupt(0x0);
+    entry->fn(sp);
+    disable_interrupt();
+    preempt_enable();
+    syscall_account(syscall_num, read_cntpct() - start);
 }
 
-void irq_handler(void) {
+void irq_handler(trapframe_t *tf) {
     unsigned int cpu_irq_src;
     // uart_send_string("irq handler\r\n");
     unsigned long daif = disable_interrupt();
-    handle_signal();
+    if ((tf->spsr_el1 & 0xf) == 0) {
+        acct_enter_kernel(current_thread);
+    }
 
     cpu_irq_src = get32(CORE0_IRQ_SRC);
 
+    if ((cpu_irq_src & (1 << 8)) && (get32(IRQ_PENDING_1) & AUX_IRQ)) {
+        // uart interrupt (routed through the GPU pending register)
+        unsigned int iir = get32(AUX_MU_IIR_REG);
+        if (iir & 0b100) {
+            receive_handler();
+        }
+        if (iir & 0b010) {
+            transmit_handler();
+        }
+    }
+
     if (cpu_irq_src & 0x2) {
         // timer interrupt
         timer_handler();
     } else {
         // uart_send_string("Unknown CPU interrupt\r\n");
     }
+    irq_exit(); // bottom halves, with interrupts enabled
+    if ((tf->spsr_el1 & 0xf) == 0) {
+        exit_to_user(tf); // back to EL0: act on a pending preemption, kill or signal
+        acct_return_to_user(current_thread);
+    } else if (need_resched && !in_softirq() && current_thread->preempt_count == 0) {
+        schedule(); // a kernel thread waiting with interrupts enabled, e.g. idle
+    }
     enable_interrupt(daif);
 }
 
 
-void timer_handler(void) {
-    // uart_send_string("timer handler\r\n");
-    asm volatile (
-        "mrs x0, cntfrq_el0\n"
-        "lsr x0, x0, 5\n" // set timer to 1/32 sec
-        "msr cntp_tval_el0, x0\n" // set expired time
-    );
-    schedule();
+void receive_handler(void) {
+    int received = 0;
+    while (get32(AUX_MU_LSR_REG) & 0x01) { // drain the RX FIFO
+        char c = get32(AUX_MU_IO_REG) & 0xFF;
+        if ((read_rear + 1) % MAX_BUFFER_SIZE == read_front) {
+            continue; // buffer full: drop the character
+        }
+        read_buffer[read_rear] = c;
+        uart_ring_barrier(); // the character before the index that publishes it
+        read_rear = (read_rear + 1) % MAX_BUFFER_SIZE;
+        received = 1;
+    }
+    if (received) {
+        tasklet_schedule(&uart_rx_tasklet); // wake the readers outside the hard interrupt
+    }
 }
 
-void handle_signal() {
-    // int signal = current_thread->signal;
-    // if (signal == SIGKILL) {
-    //     if (signal_handler[SIGKILL] != NULL) {
-    //         void *handler_kernel_stack_base = allocate(0x1000); // allocate a new stack for the signal handler
-    //         current_thread->signal_kernel_stack_base = handler_kernel_stack_base;
-    //         void *handler_stack_base = allocate(0x1000); // allocate a new stack for the signal handler
-    //         current_thread->signal_stack_base = handler_stack_base;
-    //         memset(handler_kernel_stack_base, 0, 0x1000);
-    //         memset(handler_stack_base, 0, 0x1000);
-    //         void *handler_stack = (void *)((unsigned long)handler_stack_base + 0x1000);
-    //         void *handler_kernel_stack = (void *)((unsigned long)handler_kernel_stack_base + 0x1000);
-    //         current_thread->signal = 0; // clear the signal
-
-    //         switch_to_signal_handler(
-    //             current_thread->context,
-    //             current_thread->signal_context,
-    //             handler_stack,
-    //             signal_handler[SIGKILL],
-    //             handler_kernel_stack,
-    //             handler_kernel_stack_base
-    //         );
-    //         asm volatile ( "add sp, sp, 0x30"); // discard arguments 
-
-    //     } else {
-    //         sys_exit(NULL);
-    //     }
-    // }
+// the TX FIFO ran empty: refill it from write_buffer
+void transmit_handler(void) {
+    while (write_front != write_rear && (get32(AUX_MU_LSR_REG) & 0x20)) {
+        put32(AUX_MU_IO_REG, write_buffer[write_front]);
+        uart_ring_barrier(); // the slot is free only once it has been read
+        write_front = (write_front + 1) % MAX_BUFFER_SIZE;
+    }
+    if (write_front == write_rear) {
+        put32(AUX_MU_IER_REG, AUX_MU_IER_RX); // the next uart_send() turns it on again
+    }
 }
 
-void switch_to_signal_handler(
-    unsigned long *normal_context,
-    unsigned long *signal_context,
-    void *handler_stack,
-    void *handler,
-    void *kernel_stack,
-    void *kernel_stack_base
-) {
-    asm volatile (
-        "stp x19, x20, [x1, 16 * 0]\n"
-        "stp x21, x22, [x1, 16 * 1]\n"
-        "stp x23, x24, [x1, 16 * 2]\n"
-        "stp x25, x26, [x1, 16 * 3]\n"
-        "stp x27, x28, [x1, 16 * 4]\n"
-        "stp fp, lr, [x1, 16 * 5]\n"
-        "mov x9, sp\n"
-        "str x9, [x1, 16 * 6]\n" // save the normal context
-
-        "mov fp, x5\n"
-        "mov sp, x4\n"
-        "mov lr, %0\n" // set the link register to the signal handler
-
-        "mov x9, 0\n"
-        "msr spsr_el1, x9\n" // set the SPSR to the signal context
-        "msr elr_el1, x3\n"
-        "msr sp_el0, x2\n" // set the stack pointer to the signal handler stack
-        "msr tpidr_el1, x0\n" // set the thread pointer to the kernel stack
-        "eret\n" // return to the signal handler
-        : /* no output */
-        : "r" (sigreturn)
-    );
+void timer_handler(void) {
+    // uart_send_string("timer handler\r\n");
+    timer_stop(); // acknowledge; the timer softirq arms the next event
+    raise_softirq(TIMER_SOFTIRQ);
 }
-
-void sigreturn() {
-    asm volatile (
-        "mov x8, 10\n"
-        "svc 0\n" // syscall to return from signal handler
-    );
-}
\ No newline at end of file
@@ -0,0 +1,100 @@
+#include <stddef.h>
+#include "allocator.h"
+#include "exception_handler.h"
+#include "fpsimd.h"
+#include "mini_uart.h"
+#include "thread.h"
+#include "utils.h"
+
+_Static_assert(sizeof(struct fpsimd_state) == 528, "fpsimd.S stores fpsr/fpcr at offset 512");
+
+thread_t *fpsimd_owner[NR_CPUS];
+
+static inline void cpacr_set_fpen(unsigned long fpen) {
+    unsigned long cpacr;
+    asm volatile ("mrs %0, cpacr_el1\n" : "=r" (cpacr));
+    if ((cpacr & CPACR_FPEN_MASK) == fpen) {
+        return;
+    }
+    cpacr = (cpacr & ~CPACR_FPEN_MASK) | fpen;
+    asm volatile (
+        "msr cpacr_el1, %0\n"
+        "isb\n"
+        : /* no output */
+        : "r" (cpacr)
+    );
+}
+
+// per CPU: the kernel may save/restore, EL0 traps until it owns the registers
+void fpsimd_init(void) {
+    fpsimd_owner[smp_processor_id()] = NULL;
+    cpacr_set_fpen(CPACR_FPEN_EL0_TRAP);
+}
+
+// called by schedule() with interrupts masked, before switching to next
+void fpsimd_switch(thread_t *next) {
+    if (fpsimd_owner[smp_processor_id()] == next) {
+        cpacr_set_fpen(CPACR_FPEN_NO_TRAP); // its state is still in the registers
+    } else {
+        cpacr_set_fpen(CPACR_FPEN_EL0_TRAP);
+    }
+}
+
+// EL0 executed an FP/SIMD instruction while trapping: hand it the registers
+void do_fpsimd_acc(void) {
+    int cpu = smp_processor_id();
+    thread_t *t = current_thread;
+    if (t->fpsimd == NULL) { // first use: start from all zeroes
+        t->fpsimd = allocate(sizeof(struct fpsimd_state));
+        if (t->fpsimd == NULL) {
+            uart_send_string("[ERROR | FPSIMD] Out of memory\r\n");
+            thread_kill(t, -1);
+            return;
+        }
+        memset((char *)t->fpsimd, 0, sizeof(struct fpsimd_state));
+    }
+    thread_t *owner = fpsimd_owner[cpu];
+    if (owner != t) {
+        if (owner != NULL) {
+            fpsimd_save_state(owner->fpsimd);
+        }
+        fpsimd_load_state(t->fpsimd);
+        fpsimd_owner[cpu] = t;
+    }
+    cpacr_set_fpen(CPACR_FPEN_NO_TRAP); // the instruction is retried on return
+}
+
+// the child starts with a copy of the parent's FP/SIMD state, if it has one
+int fpsimd_fork(thread_t *child, thread_t *parent) {
+    child->fpsimd = NULL;
+    if (parent->fpsimd == NULL) {
+        return 0;
+    }
+    child->fpsimd = allocate(sizeof(struct fpsimd_state));
+    if (child->fpsimd == NULL) {
+        return -1;
+    }
+    if (fpsimd_owner[smp_processor_id()] == parent) {
+        fpsimd_save_state(parent->fpsimd); // live values are newer than the saved ones
+    }
+    memcpy(child->fpsimd, parent->fpsimd, sizeof(struct fpsimd_state));
+    return 0;
+}
+
+// forget t's state, e.g. on exit or exec; the thread traps again on next use
+void fpsimd_release(thread_t *t) {
+    unsigned long daif = disable_interrupt();
+    for (int cpu = 0; cpu < NR_CPUS; ++cpu) {
+        if (fpsimd_owner[cpu] == t) {
+            fpsimd_owner[cpu] = NULL;
+        }
+    }
+    if (t == current_thread) {
+        cpacr_set_fpen(CPACR_FPEN_EL0_TRAP);
+    }
+    enable_interrupt(daif);
+    if (t->fpsimd != NULL) {
+        free(t->fpsimd);
+        t->fpsimd = NULL;
+    }
+}
@@ -3,6 +3,7 @@
 #include "mailbox.h"
 #include "mini_uart.h"
 #include "framebufferfs.h"
+#include "poll.h"
 #include "utils.h"
 #include "vfs.h"
 
@@ -11,12 +12,14 @@ static int read(struct file* file, void* buf, size_t len);
 static int open(struct vnode* file_node, struct file** target);
 static int close(struct file* file);
 static long lseek64(struct file* file, long offset, int whence);
+static unsigned int poll(struct file* file, struct poll_table* pt);
 struct file_operations framebufferfs_fops = {
     .write = write,
     .read = read,
     .open = open,
     .close = close,
     .lseek64 = lseek64,
+    .poll = poll,
 };
 
 static int lookup(struct vnode* dir_node, struct vnode** target,
@@ -83,8 +86,12 @@ static int close(struct file* file) {
 
 static long lseek64(struct file* file, long offset, int whence) {
     // uart_send_string("[FRAMEBUFFERFS] lseek64 called\r\n");
-    file->f_pos = (size_t)offset;
-    return offset; // Seek successful
+    size_t size = (size_t)pitch * height; // 0 until the framebuffer is set up
+    return generic_file_lseek(file, offset, whence, size, size);
+}
+
+static unsigned int poll(struct file* file, struct poll_table* pt) {
+    return POLLOUT; // plain memory, writes never wait; reads aren't supported
 }
 
 static int lookup(struct vnode* dir_node, struct vnode** target,
@@ -0,0 +1,101 @@
+#include <stddef.h>
+#include "futex.h"
+#include "mmu.h"
+#include "spinlock.h"
+#include "thread.h"
+#include "timer.h"
+
+static futex_bucket_t futex_queues[FUTEX_HASH_SIZE];
+
+void futex_init(void) {
+    for (int i = 0; i < FUTEX_HASH_SIZE; ++i) {
+        spin_lock_init(&futex_queues[i].lock, "futex");
+        futex_queues[i].head = NULL;
+    }
+}
+
+// physical address of the user word, 0 if unusable
+static unsigned long futex_key(unsigned int *uaddr) {
+    if ((unsigned long)uaddr & 0x3) {
+        return 0; // the word must be naturally aligned
+    }
+    return walk_addr(current_thread->pgd, (unsigned long)uaddr);
+}
+
+static inline futex_bucket_t *hash_futex(unsigned long key) {
+    return &futex_queues[(key >> 2) & (FUTEX_HASH_SIZE - 1)];
+}
+
+/*
+    Sleep if *uaddr still holds val, checked under the bucket lock so a
+    concurrent futex_wake() can't slip in between. timeout is in counter
+    ticks, 0 for none. Returns 0 when woken by futex_wake(), -1 if the
+    value changed, the timeout expired or the thread was killed.
+*/
+long futex_wait(unsigned int *uaddr, unsigned int val, unsigned long timeout) {
+    unsigned long key = futex_key(uaddr);
+    if (key == 0) {
+        return -1;
+    }
+    futex_bucket_t *bucket = hash_futex(key);
+    futex_q_t q = { NULL, current_thread, key, 0 };
+
+    unsigned long flags;
+    spin_lock_irqsave(&bucket->lock, flags);
+    if (*(volatile unsigned int *)uaddr != val) {
+        spin_unlock_irqrestore(&bucket->lock, flags);
+        return -1; // changed already: the caller retries in user space
+    }
+    futex_q_t **link = &bucket->head;
+    while (*link != NULL) {
+        link = &(*link)->next; // FIFO: the longest waiter is woken first
+    }
+    *link = &q;
+    current_thread->state = THREAD_WAITING; // a wakeup from here on is not lost
+    spin_unlock_irqrestore(&bucket->lock, flags);
+
+    if (timeout != 0) {
+        schedule_timeout(timeout);
+    } else {
+        schedule();
+    }
+
+    spin_lock_irqsave(&bucket->lock, flags);
+    if (!q.woken) { // timed out or killed: still queued
+        for (futex_q_t **link = &bucket->head; *link != NULL; link = &(*link)->next) {
+            if (*link == &q) {
+                *link = q.next;
+                break;
+            }
+        }
+    }
+    spin_unlock_irqrestore(&bucket->lock, flags);
+    return q.woken ? 0 : -1;
+}
+
+// wake at most nr_wake waiters on uaddr, returns how many were woken
+long futex_wake(unsigned int *uaddr, int nr_wake) {
+    unsigned long key = futex_key(uaddr);
+    if (key == 0) {
+        return -1;
+    }
+    futex_bucket_t *bucket = hash_futex(key);
+    long woken = 0;
+
+    unsigned long flags;
+    spin_lock_irqsave(&bucket->lock, flags);
+    futex_q_t **link = &bucket->head;
+    while (*link != NULL && woken < nr_wake) {
+        futex_q_t *q = *link;
+        if (q->key != key) {
+            link = &q->next;
+            continue;
+        }
+        *link = q->next;
+        q->woken = 1;
+        thread_wakeup(q->task);
+        woken++;
+    }
+    spin_unlock_irqrestore(&bucket->lock, flags);
+    return woken;
+}
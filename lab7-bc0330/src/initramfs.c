@@ -15,12 +15,14 @@ static int read(struct file* file, void* buf, size_t len);
 static int open(struct vnode* file_node, struct file** target);
 static int close(struct file* file);
 static long lseek64(struct file* file, long offset, int whence);
+static int pread(struct file* file, void* buf, size_t len, size_t pos);
 struct file_operations initramfs_fops = {
     .write = write,
     .read = read,
     .open = open,
     .close = close,
     .lseek64 = lseek64,
+    .pread = pread,
 };
 
 static int lookup(struct vnode* dir_node, struct vnode** target,
@@ -159,22 +161,31 @@ static int write(struct file* file, const void* buf, size_t len) {
     return -1; // Initramfs is read-only, writing is not allowed
 }
 
-static int read(struct file* file, void* buf, size_t len) {
+static int pread(struct file* file, void* buf, size_t len, size_t pos) {
     struct vnode* node = file->vnode;
     initramfs_internal_t* inter = (initramfs_internal_t*)node->internal;
     if ((inter->mode & S_IFMT) != S_IFREG) {                      // Check if it's a regular file
         uart_send_string("[ERROR | Read] Not a regular file\r\n");
         return -1; // Not a regular file
     }
-    
-    size_t to_read = (file->f_pos + len > inter->size)?
-                     (inter->size - file->f_pos) : len;       // don't exceed max size
-    memcpy(buf, (char*)inter->content + file->f_pos, to_read);
-    file->f_pos += to_read;
+    if (pos >= inter->size) {
+        return 0; // End of file
+    }
 
+    size_t to_read = (pos + len > inter->size)?
+                     (inter->size - pos) : len;       // don't exceed the file size
+    memcpy(buf, (char*)inter->content + pos, to_read);
     return (int)to_read;
 }
 
+static int read(struct file* file, void* buf, size_t len) {
+    int bytes_read = pread(file, buf, len, file->f_pos);
+    if (bytes_read > 0) {
+        file->f_pos += bytes_read;
+    }
+    return bytes_read;
+}
+
 static int open(struct vnode* file_node, struct file** target) {
     return 0; // Open successful
 }
@@ -185,7 +196,8 @@ static int close(struct file* file) {
 }
 
 static long lseek64(struct file* file, long offset, int whence) {
-    return 0; // Seek successful
+    initramfs_internal_t* inter = (initramfs_internal_t*)file->vnode->internal;
+    return generic_file_lseek(file, offset, whence, inter->size, inter->size); // read-only: no holes
 }
 
 static int lookup(struct vnode* dir_node, struct vnode** target,
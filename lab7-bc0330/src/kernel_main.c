@@ -1,16 +1,25 @@
 #include "allocator.h"
+#include "bench.h"
 #include "devicetree.h"
+#include "fpsimd.h"
+#include "futex.h"
 #include "mini_uart.h"
 #include "mmu.h"
 #include "rootfs.h"
+#include "schedstat.h"
 #include "shell.h"
+#include "softirq.h"
+#include "syscall.h"
 #include "thread.h"
+#include "timer.h"
 #include "user_prog.h"
 #include "vfs.h"
+#include "workqueue.h"
 
 void kernel_main(void) {
     uart_init();
     uart_send_string("Hello, world!\r\n");
+    fpsimd_init();
 
     fdt_traverse(initramfs_callback);
 
@@ -25,8 +34,19 @@ void kernel_main(void) {
     tmp |= 1;
     asm volatile("msr cntkctl_el1, %0" : : "r"(tmp));
 
+    sched_init(fdt_get_property("bootargs"));
     init_thread();
-
+    softirq_init();
+    init_timers();
+    init_workqueue();
+    futex_init();
+    schedstat_init();
+    syscallstat_init();
+    uart_enable_interrupts();
+
+#ifdef CONFIG_BENCH
+    thread_create(bench_main, MEDIUM_PRIORITY, NULL, 0);
+#endif
     exec_prog("/initramfs/vfs1.img");
     idle();
 }
\ No newline at end of file
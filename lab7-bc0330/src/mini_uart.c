@@ -1,7 +1,11 @@
+#include "exception_handler.h"
 #include "mini_uart.h"
 #include "utils.h"
 #include "gpio.h"
 #include "base.h"
+#include "signal.h"
+#include "thread.h"
+#include "wait.h"
 
 void uart_init(void) {
     unsigned int func_sel;
@@ -27,7 +31,21 @@ void uart_init(void) {
     put32(AUX_MU_CNTL_REG, 3);               // Finally, enable transmitter and receiver
 }
 
-void uart_send(char c) {
+static int uart_irq_enabled = 0; // until then both directions poll the hardware
+
+/*
+    From here on input arrives through read_buffer and output leaves
+    through write_buffer. The TX interrupt is only enabled while
+    write_buffer holds something, since it fires whenever the FIFO is empty.
+*/
+void uart_enable_interrupts(void) {
+    init_waitqueue_head(&uart_read_wait);
+    put32(AUX_MU_IER_REG, AUX_MU_IER_RX);    // Enable receive interrupt
+    put32(ENABLE_IRQS_1, AUX_IRQ);           // Route AUX (IRQ 29) to the ARM core
+    uart_irq_enabled = 1;
+}
+
+static void uart_send_polled(char c) {
     while(1) {
         if(get32(AUX_MU_LSR_REG) & 0x20)   // transmitter ready
             break;
@@ -35,7 +53,34 @@ void uart_send(char c) {
     put32(AUX_MU_IO_REG, c);
 }
 
+/*
+    Queue c for the TX interrupt. Callers with interrupts masked, like
+    kernel threads, still only wait for the UART once the ring is full:
+    then the oldest character is sent by hand to make room, the one place
+    besides the TX interrupt that advances write_front.
+*/
+void uart_send(char c) {
+    if (!uart_irq_enabled) {
+        uart_send_polled(c);
+        return;
+    }
+    unsigned long daif = disable_interrupt(); // the TX interrupt can't run meanwhile
+    int next = (write_rear + 1) % MAX_BUFFER_SIZE;
+    if (next == write_front) {
+        uart_send_polled(write_buffer[write_front]);
+        write_front = (write_front + 1) % MAX_BUFFER_SIZE;
+    }
+    write_buffer[write_rear] = c;
+    uart_ring_barrier(); // the character before the index that publishes it
+    write_rear = next;
+    put32(AUX_MU_IER_REG, AUX_MU_IER_RX | AUX_MU_IER_TX);
+    enable_interrupt(daif);
+}
+
 char uart_recv(void) {
+    if (uart_irq_enabled) {
+        return uart_getc(); // the RX interrupt drains the FIFO now; the shell is never killed
+    }
     while(1) {
         if(get32(AUX_MU_LSR_REG) & 0x01)   // data ready
             break;
@@ -43,6 +88,23 @@ char uart_recv(void) {
     return(get32(AUX_MU_IO_REG) & 0xFF);   // char -> 8-bit
 }
 
+/*
+    Blocking read: sleeps on uart_read_wait until the RX interrupt queued
+    data. Returns the character, or -1 if a kill or signal came first.
+*/
+int uart_getc(void) {
+    wait_event(uart_read_wait, read_front != read_rear
+            || current_thread->killed || signal_pending(current_thread));
+    if (read_front == read_rear) {
+        return -1; // interrupted
+    }
+    uart_ring_barrier(); // read_rear was published after the character
+    char c = read_buffer[read_front];
+    uart_ring_barrier(); // done with the slot before handing it back
+    read_front = (read_front + 1) % MAX_BUFFER_SIZE;
+    return (unsigned char)c;
+}
+
 void uart_send_string(char *str) {
     for (int i = 0; str[i] != '\0'; ++i) {
         uart_send(str[i]);
@@ -1,8 +1,13 @@
 #include "allocator.h"
 #include "mini_uart.h"
 #include "mmu.h"
+#include "spinlock.h"
 #include "utils.h"
 
+// PTE tables of the peripheral window, built once and linked into every user pgd
+static unsigned long peripheral_pte[(PERIPHERAL_END - PERIPHERAL_START) / PMD_GRANULARITY];
+static DEFINE_SPINLOCK(peripheral_lock);
+
 void finer_granularity_paging(void) {
     /* Third-level 2MB block mapping and Forth-level 4KB page mapping*/
     unsigned long *pmd_1 = (unsigned long *)ptov(0x2000ul); 
@@ -39,10 +44,14 @@ void finer_granularity_paging(void) {
     pud[1] = 0x3000 | PD_TABLE; // 2nd 1GB mapped by the 2nd entry of PUD
 }
 
-void mappages(unsigned long *pgd, unsigned long vaddr, unsigned long paddr, unsigned long attr) {
+/*
+    Walk from pgd down to the table of the given level (0: PTE table),
+    allocating the missing intermediate tables.
+*/
+static unsigned long *walk_create(unsigned long *pgd, unsigned long vaddr, int stop_level) {
     unsigned long *table = pgd;
     size_t index = 0;
-    for (char level = 3; level > 0; --level) {
+    for (char level = 3; level > stop_level; --level) {
         index = (vaddr >> (level * 9 + 12)) & 0x1FF; // 9 bits for each level, 12 bits for offset
         if (table[index] == 0) {
             void *page = allocate(PAGE_SIZE); // allocate a new page table
@@ -53,13 +62,121 @@ void mappages(unsigned long *pgd, unsigned long vaddr, unsigned long paddr, unsi
             table = (unsigned long *)ptov((table[index] & 0xFFFFFFFFF000UL)); // move to the next level
         }
     }
-    index = (vaddr >> 12) & 0x1FF; // last level index for 4KB page
+    return table;
+}
+
+void mappages(unsigned long *pgd, unsigned long vaddr, unsigned long paddr, unsigned long attr) {
+    unsigned long *table = walk_create(pgd, vaddr, 0);
+    size_t index = (vaddr >> 12) & 0x1FF; // last level index for 4KB page
     table[index] = paddr | attr | PD_ACCESS | (MAIR_IDX_NORMAL_NOCACHE << 2) | PD_PAGE; // 4KB page
 }
 
+// remove the 4KB mapping of vaddr from pgd, if any, and drop it from the TLB
+void unmappages(unsigned long *pgd, unsigned long vaddr) {
+    unsigned long *table = pgd;
+    for (int level = 3; level > 0; --level) {
+        unsigned long desc = table[(vaddr >> (level * 9 + 12)) & 0x1FF];
+        if ((desc & 0b11) != PD_TABLE) {
+            return; // not mapped with 4KB pages
+        }
+        table = (unsigned long *)ptov((desc & 0xFFFFFFFFF000UL));
+    }
+    table[(vaddr >> 12) & 0x1FF] = 0;
+    asm volatile (
+        "dsb ishst\n"         // the cleared descriptor is visible to the walker
+        "tlbi vaae1is, %0\n"  // any ASID, all cores
+        "dsb ish\n"
+        "isb\n"
+        : : "r" (vaddr >> 12) : "memory"
+    );
+}
+
+// load pgd into TTBR0_EL1 without a context switch, as switch_to() does
+void switch_pgd(unsigned long *pgd) {
+    asm volatile (
+        "dsb ish\n"
+        "msr ttbr0_el1, %0\n"
+        "tlbi vmalle1is\n"
+        "dsb ish\n"
+        "isb\n"
+        : : "r" (vtop((unsigned long)pgd)) : "memory"
+    );
+}
+
+// physical address vaddr maps to in pgd, 0 if it is not mapped
+unsigned long walk_addr(unsigned long *pgd, unsigned long vaddr) {
+    unsigned long *table = pgd;
+    for (int level = 3; level >= 0; --level) {
+        unsigned long desc = table[(vaddr >> (level * 9 + 12)) & 0x1FF];
+        if ((desc & 0b11) == 0) {
+            return 0; // invalid descriptor
+        }
+        unsigned long pa = desc & 0xFFFFFFFFF000UL;
+        if (level == 0 || (desc & 0b11) == PD_BLOCK) {
+            unsigned long mask = (1UL << (level * 9 + 12)) - 1; // page or block offset
+            return (pa & ~mask) | (vaddr & mask);
+        }
+        table = (unsigned long *)ptov(pa);
+    }
+    return 0;
+}
+
+
+static int is_peripheral_pte(unsigned long desc) {
+    for (size_t i = 0; i < sizeof(peripheral_pte) / sizeof(peripheral_pte[0]); ++i) {
+        if (peripheral_pte[i] == desc) {
+            return 1;
+        }
+    }
+    return 0;
+}
 
+/*
+    Free a user page table tree built by mappages(): the table pages of
+    every level, but not the pages they map, which belong to the thread
+    (stacks, program) or are device memory.
+*/
+static void free_table(unsigned long *table, int level) {
+    if (level > 0) {
+        for (size_t i = 0; i < 512; ++i) {
+            if (level == 1 && is_peripheral_pte(table[i])) {
+                continue; // shared by all threads
+            }
+            if ((table[i] & 0b11) == PD_TABLE) {
+                free_table((unsigned long *)ptov((table[i] & 0xFFFFFFFFF000UL)), level - 1);
+            }
+        }
+    }
+    free(table);
+}
+
+void free_page_tables(unsigned long *pgd) {
+    free_table(pgd, 3); // PGD -> PUD -> PMD -> PTE
+}
+
+/*
+    Identity map the peripheral window for EL0. The 24 PTE tables are
+    filled on the first call and afterwards only linked into the PMD of
+    each new pgd, instead of 12288 mappages() calls per thread.
+*/
 void setup_thread_peripherals(unsigned long *pgd) {
-    for (size_t i = 0x3C000000; i < 0x3F000000; i += PAGE_SIZE) {
-        mappages(pgd, i, i, PD_USR_ACCESS);
+    unsigned long flags;
+    size_t nr_tables = sizeof(peripheral_pte) / sizeof(peripheral_pte[0]);
+    spin_lock_irqsave(&peripheral_lock, flags);
+    if (peripheral_pte[0] == 0) {
+        for (size_t i = 0; i < nr_tables; ++i) {
+            unsigned long *pte = (unsigned long *)allocate(PAGE_SIZE);
+            unsigned long base = PERIPHERAL_START + i * PMD_GRANULARITY;
+            for (size_t j = 0; j < 512; ++j) { // same attributes as mappages(pgd, pa, pa, PD_USR_ACCESS)
+                pte[j] = (base + j * PAGE_SIZE) | PD_USR_ACCESS | PD_ACCESS | (MAIR_IDX_NORMAL_NOCACHE << 2) | PD_PAGE;
+            }
+            peripheral_pte[i] = vtop((unsigned long)pte) | PD_TABLE;
+        }
+    }
+    spin_unlock_irqrestore(&peripheral_lock, flags);
+
+    unsigned long *pmd = walk_create(pgd, PERIPHERAL_START, 1); // the window lies within one PMD table
+    for (size_t i = 0; i < nr_tables; ++i) {
+        pmd[((PERIPHERAL_START >> 21) & 0x1FF) + i] = peripheral_pte[i];
     }
 }
\ No newline at end of file
@@ -0,0 +1,114 @@
+#include <stddef.h>
+#include "mini_uart.h"
+#include "pid.h"
+#include "spinlock.h"
+#include "thread.h"
+
+#define BITS_PER_LONG 64
+
+static unsigned long pid_bitmap[PID_MAX / BITS_PER_LONG]; // bit set <=> id in use
+static pid_t last_pid = PID_INVALID;    // first search starts at 0
+static thread_t *pid_hash[PID_HASH_SIZE];
+static DEFINE_SPINLOCK(pid_lock);       // protects pid_bitmap, last_pid and pid_hash
+
+static inline unsigned int pid_hashfn(pid_t pid) {
+    return pid & (PID_HASH_SIZE - 1); // ids are dense, the low bits spread them well
+}
+
+void init_pid(void) {
+    for (int i = 0; i < PID_MAX / BITS_PER_LONG; ++i) {
+        pid_bitmap[i] = 0;
+    }
+    for (int i = 0; i < PID_HASH_SIZE; ++i) {
+        pid_hash[i] = NULL;
+    }
+    last_pid = PID_INVALID;
+}
+
+pid_t alloc_pid(void) {
+    unsigned long flags;
+    pid_t pid = PID_INVALID;
+    spin_lock_irqsave(&pid_lock, flags);
+    pid_t start = (last_pid + 1) % PID_MAX;
+    for (int n = 0; n <= PID_MAX / BITS_PER_LONG; ++n) {
+        // word containing start first, the remaining words after wrapping around
+        int word = (start / BITS_PER_LONG + n) % (PID_MAX / BITS_PER_LONG);
+        unsigned long free_bits = ~pid_bitmap[word];
+        if (n == 0) {
+            free_bits &= ~0UL << (start % BITS_PER_LONG); // ids below start come last
+        } else if (n == PID_MAX / BITS_PER_LONG) {
+            free_bits &= ~(~0UL << (start % BITS_PER_LONG));
+        }
+        if (free_bits != 0) {
+            int bit = __builtin_ctzl(free_bits);
+            pid_bitmap[word] |= 1UL << bit;
+            pid = word * BITS_PER_LONG + bit;
+            last_pid = pid;
+            break;
+        }
+    }
+    spin_unlock_irqrestore(&pid_lock, flags);
+    if (pid == PID_INVALID) {
+        uart_send_string("[ERROR | PID] Out of thread ids\r\n");
+    }
+    return pid;
+}
+
+void free_pid(pid_t pid) {
+    unsigned long flags;
+    if (pid >= PID_MAX) {
+        return;
+    }
+    spin_lock_irqsave(&pid_lock, flags);
+    pid_bitmap[pid / BITS_PER_LONG] &= ~(1UL << (pid % BITS_PER_LONG));
+    spin_unlock_irqrestore(&pid_lock, flags);
+}
+
+void attach_pid(thread_t *t) {
+    unsigned long flags;
+    unsigned int bucket = pid_hashfn(t->id);
+    spin_lock_irqsave(&pid_lock, flags);
+    t->pid_next = pid_hash[bucket];
+    pid_hash[bucket] = t;
+    spin_unlock_irqrestore(&pid_lock, flags);
+}
+
+void detach_pid(thread_t *t) {
+    unsigned long flags;
+    spin_lock_irqsave(&pid_lock, flags);
+    thread_t **link = &pid_hash[pid_hashfn(t->id)];
+    while (*link != NULL) {
+        if (*link == t) {
+            *link = t->pid_next;
+            break;
+        }
+        link = &(*link)->pid_next;
+    }
+    t->pid_next = NULL;
+    spin_unlock_irqrestore(&pid_lock, flags);
+}
+
+thread_t *find_thread_by_pid(pid_t pid) {
+    unsigned long flags;
+    thread_t *t;
+    spin_lock_irqsave(&pid_lock, flags);
+    for (t = pid_hash[pid_hashfn(pid)]; t != NULL; t = t->pid_next) {
+        if (t->id == pid) {
+            break;
+        }
+    }
+    spin_unlock_irqrestore(&pid_lock, flags);
+    return t;
+}
+
+// fn runs with pid_lock held, so it must not sleep or create threads
+void for_each_thread(void (*fn)(thread_t *t, void *arg), void *arg) {
+    unsigned long flags;
+    spin_lock_irqsave(&pid_lock, flags);
+    for (int i = 0; i < PID_HASH_SIZE; ++i) {
+        for (thread_t *t = pid_hash[i]; t != NULL; t = t->pid_next) {
+            fn(t, arg);
+        }
+    }
+    spin_unlock_irqrestore(&pid_lock, flags);
+}
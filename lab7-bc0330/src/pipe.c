@@ -0,0 +1,269 @@
+#include <stddef.h>
+#include "allocator.h"
+#include "pipe.h"
+#include "poll.h"
+#include "signal.h"
+#include "spinlock.h"
+#include "thread.h"
+#include "utils.h"
+#include "vfs.h"
+#include "wait.h"
+
+#define PIPE_MASK (PIPE_BUFFERS - 1)
+
+static DEFINE_SPINLOCK(pipe_lock); // head, tail, the buffers and the end counts of every pipe
+
+static int write(struct file* file, const void* buf, size_t len);
+static int read(struct file* file, void* buf, size_t len);
+static int open(struct vnode* file_node, struct file** target);
+static int close(struct file* file);
+static long lseek64(struct file* file, long offset, int whence);
+static unsigned int poll(struct file* file, struct poll_table* pt);
+static struct file_operations pipe_fops = {
+    .write = write,
+    .read = read,
+    .open = open,
+    .close = close,
+    .lseek64 = lseek64,
+    .poll = poll,
+};
+
+static int pipe_empty(pipe_t *pipe) {
+    return pipe->head == pipe->tail;
+}
+
+static int pipe_full(pipe_t *pipe) {
+    return pipe->head - pipe->tail >= PIPE_BUFFERS;
+}
+
+// newest page if more bytes fit behind its data, NULL otherwise
+static struct pipe_buffer *pipe_last_open(pipe_t *pipe) {
+    if (pipe_empty(pipe)) {
+        return NULL;
+    }
+    struct pipe_buffer *last = &pipe->bufs[(pipe->head - 1) & PIPE_MASK];
+    return last->offset + last->len < PAGE_SIZE ? last : NULL;
+}
+
+static int pipe_writable(pipe_t *pipe) {
+    return !pipe_full(pipe) || pipe_last_open(pipe) != NULL;
+}
+
+// a sleeping reader or writer gives up for these, like waitpid() does
+static int pipe_interrupted(void) {
+    return current_thread->killed || signal_pending(current_thread);
+}
+
+// move a filled page into the ring; -1 if it filled up meanwhile
+static int pipe_gift_page(pipe_t *pipe, char *page, size_t len) {
+    unsigned long flags;
+    spin_lock_irqsave(&pipe_lock, flags);
+    if (pipe_full(pipe)) {
+        spin_unlock_irqrestore(&pipe_lock, flags);
+        return -1;
+    }
+    struct pipe_buffer *buf = &pipe->bufs[pipe->head & PIPE_MASK];
+    buf->page = page;
+    buf->offset = 0;
+    buf->len = len;
+    pipe->head++;
+    spin_unlock_irqrestore(&pipe_lock, flags);
+    return 0;
+}
+
+static int write(struct file* file, const void* buf, size_t len) {
+    pipe_t *pipe = (pipe_t *)file->vnode->internal;
+    if (file->flags != O_WRONLY) {
+        return -1; // the read end
+    }
+    size_t written = 0;
+    while (written < len) {
+        wait_event(pipe->wr_wait, pipe_writable(pipe) || pipe->readers == 0 || pipe_interrupted());
+        if (pipe->readers == 0) {
+            send_signal(current_thread, SIGPIPE);
+            return written > 0 ? (int)written : -1;
+        }
+        if (pipe_interrupted()) {
+            break;
+        }
+
+        size_t left = len - written;
+        unsigned long flags;
+        spin_lock_irqsave(&pipe_lock, flags);
+        struct pipe_buffer *last = pipe_last_open(pipe);
+        if (last != NULL && (left < PAGE_SIZE || pipe_full(pipe))) {
+            // top up the newest page
+            size_t room = PAGE_SIZE - (last->offset + last->len);
+            size_t n = left < room ? left : room;
+            memcpy(last->page + last->offset + last->len, (const char *)buf + written, n);
+            last->len += n;
+            written += n;
+            spin_unlock_irqrestore(&pipe_lock, flags);
+        } else {
+            spin_unlock_irqrestore(&pipe_lock, flags);
+            size_t n = left < PAGE_SIZE ? left : PAGE_SIZE;
+            char *page = allocate(PAGE_SIZE);
+            if (page == NULL) {
+                break;
+            }
+            memcpy(page, (const char *)buf + written, n); // filled before it is visible
+            if (pipe_gift_page(pipe, page, n) != 0) {
+                free(page);
+                continue;
+            }
+            written += n;
+        }
+        wake_up(&pipe->rd_wait);
+    }
+    return written > 0 || len == 0 ? (int)written : -1;
+}
+
+// whatever is there up to len, a page at a time so interrupts are masked only briefly
+static size_t pipe_copy_out(pipe_t *pipe, char *buf, size_t len) {
+    size_t copied = 0;
+    while (copied < len) {
+        unsigned long flags;
+        spin_lock_irqsave(&pipe_lock, flags);
+        if (pipe_empty(pipe)) {
+            spin_unlock_irqrestore(&pipe_lock, flags);
+            break;
+        }
+        struct pipe_buffer *oldest = &pipe->bufs[pipe->tail & PIPE_MASK];
+        size_t n = len - copied < oldest->len ? len - copied : oldest->len;
+        memcpy(buf + copied, oldest->page + oldest->offset, n);
+        oldest->offset += n;
+        oldest->len -= n;
+        copied += n;
+        char *drained = NULL;
+        if (oldest->len == 0) {
+            drained = oldest->page;
+            oldest->page = NULL;
+            pipe->tail++;
+        }
+        spin_unlock_irqrestore(&pipe_lock, flags);
+        if (drained != NULL) {
+            free(drained);
+        }
+    }
+    return copied;
+}
+
+static int read(struct file* file, void* buf, size_t len) {
+    pipe_t *pipe = (pipe_t *)file->vnode->internal;
+    if (file->flags != O_RDONLY) {
+        return -1; // the write end
+    }
+    if (len == 0) {
+        return 0;
+    }
+    while (1) {
+        wait_event(pipe->rd_wait, !pipe_empty(pipe) || pipe->writers == 0 || pipe_interrupted());
+        size_t copied = pipe_copy_out(pipe, (char *)buf, len);
+        if (copied != 0) {
+            wake_up(&pipe->wr_wait);
+            return (int)copied;
+        }
+        if (pipe->writers == 0) {
+            return 0; // end of file
+        }
+        if (pipe_interrupted()) {
+            return -1;
+        }
+        // another reader was faster
+    }
+}
+
+static int open(struct vnode* file_node, struct file** target) {
+    return -1; // only pipe() creates the ends
+}
+
+static int close(struct file* file) {
+    pipe_t *pipe = (pipe_t *)file->vnode->internal;
+    unsigned long flags;
+    spin_lock_irqsave(&pipe_lock, flags);
+    if (file->flags == O_WRONLY) {
+        pipe->writers--;
+    } else {
+        pipe->readers--;
+    }
+    int unused = pipe->readers == 0 && pipe->writers == 0;
+    spin_unlock_irqrestore(&pipe_lock, flags);
+    free(file);  // Free the file handle
+
+    if (!unused) {
+        wake_up(&pipe->rd_wait); // end of file for the readers
+        wake_up(&pipe->wr_wait); // broken pipe for the writers
+        return 0;
+    }
+    while (!pipe_empty(pipe)) {
+        free(pipe->bufs[pipe->tail & PIPE_MASK].page);
+        pipe->tail++;
+    }
+    free(pipe);
+    return 0;
+}
+
+static long lseek64(struct file* file, long offset, int whence) {
+    return -1; // a pipe has no position
+}
+
+static unsigned int poll(struct file* file, struct poll_table* pt) {
+    pipe_t *pipe = (pipe_t *)file->vnode->internal;
+    unsigned int mask = 0;
+    if (file->flags == O_RDONLY) {
+        poll_wait(&pipe->rd_wait, pt);
+        if (!pipe_empty(pipe)) {
+            mask |= POLLIN;
+        }
+        if (pipe->writers == 0) {
+            mask |= POLLHUP; // read() returns end of file
+        }
+    } else {
+        poll_wait(&pipe->wr_wait, pt);
+        if (pipe->readers == 0) {
+            mask |= POLLERR; // write() fails with SIGPIPE
+        } else if (pipe_writable(pipe)) {
+            mask |= POLLOUT;
+        }
+    }
+    return mask;
+}
+
+static void pipe_file_init(struct file *file, pipe_t *pipe, int flags) {
+    file->vnode = &pipe->vnode;
+    file->f_pos = 0;
+    file->f_ops = &pipe_fops;
+    file->flags = flags;
+    file->ref = 1;
+}
+
+int pipe_create(struct file **read_end, struct file **write_end) {
+    pipe_t *pipe = allocate(sizeof(pipe_t));
+    struct file *reader = allocate(sizeof(struct file));
+    struct file *writer = allocate(sizeof(struct file));
+    if (pipe == NULL || reader == NULL || writer == NULL) {
+        if (pipe != NULL) {
+            free(pipe);
+        }
+        if (reader != NULL) {
+            free(reader);
+        }
+        if (writer != NULL) {
+            free(writer);
+        }
+        return -1;
+    }
+    memset((char *)pipe, 0, sizeof(pipe_t));
+    pipe->readers = 1;
+    pipe->writers = 1;
+    init_waitqueue_head(&pipe->rd_wait);
+    init_waitqueue_head(&pipe->wr_wait);
+    pipe->vnode.f_ops = &pipe_fops;
+    pipe->vnode.internal = pipe;
+
+    pipe_file_init(reader, pipe, O_RDONLY);
+    pipe_file_init(writer, pipe, O_WRONLY);
+    *read_end = reader;
+    *write_end = writer;
+    return 0;
+}
@@ -0,0 +1,87 @@
+#include <stddef.h>
+#include "exception_handler.h"
+#include "poll.h"
+#include "signal.h"
+#include "thread.h"
+#include "timer.h"
+#include "vfs.h"
+#include "wait.h"
+
+// called by a poll file operation with the queue its events are signalled on
+void poll_wait(wait_queue_head_t *wq, poll_table_t *pt) {
+    if (pt == NULL || !pt->registering || pt->nr == POLL_TABLE_SIZE) {
+        return;
+    }
+    wait_queue_entry_t *entry = &pt->entries[pt->nr];
+    init_wait_entry(entry);
+    add_wait_queue(wq, entry);
+    pt->queues[pt->nr++] = wq;
+}
+
+// fill in revents, returns how many descriptors have some
+static int poll_scan(struct pollfd *fds, unsigned int nfds, poll_table_t *pt) {
+    int count = 0;
+    for (unsigned int i = 0; i < nfds; ++i) {
+        struct pollfd *p = &fds[i];
+        p->revents = 0;
+        if (p->fd < 0) {
+            continue;
+        }
+        struct file *file = fd_get(current_thread, p->fd);
+        if (file == NULL) {
+            p->revents = POLLNVAL;
+        } else {
+            p->revents = vfs_poll(file, pt) & (p->events | POLLERR | POLLHUP);
+            vfs_close(file);
+        }
+        if (p->revents != 0) {
+            count++;
+        }
+    }
+    return count;
+}
+
+/*
+    timeout_ms < 0 waits forever, 0 only checks. Returns the number of
+    ready descriptors, 0 on timeout, -1 if nfds is too large or a kill
+    or signal cut the wait short.
+*/
+int do_poll(struct pollfd *fds, unsigned int nfds, long timeout_ms) {
+    if (fds == NULL || nfds > MAX_FD) {
+        return -1; // Invalid argument
+    }
+    poll_table_t pt;
+    pt.registering = 1;
+    pt.nr = 0;
+    unsigned long left = timeout_ms > 0 ? us_to_ticks(timeout_ms * 1000) : 0;
+    int count;
+    int interrupted = 0;
+
+    // as in wait_event(): a wakeup between the scan and schedule() isn't lost
+    unsigned long daif = disable_interrupt();
+    while (1) {
+        current_thread->state = THREAD_WAITING;
+        count = poll_scan(fds, nfds, &pt);
+        pt.registering = 0;
+        if (count != 0 || timeout_ms == 0) {
+            break;
+        }
+        if (current_thread->killed || signal_pending(current_thread)) {
+            interrupted = 1;
+            break;
+        }
+        if (timeout_ms < 0) {
+            schedule();
+        } else if (left == 0) {
+            break; // timed out
+        } else {
+            left = schedule_timeout(left);
+        }
+    }
+    current_thread->state = THREAD_RUNNING;
+    for (int i = 0; i < pt.nr; ++i) {
+        remove_wait_queue(pt.queues[i], &pt.entries[i]);
+    }
+    enable_interrupt(daif);
+    return interrupted ? -1 : count;
+}
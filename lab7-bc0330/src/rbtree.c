@@ -0,0 +1,227 @@
+#include <stddef.h>
+#include "rbtree.h"
+
+static void rotate_left(rb_root_t *root, rb_node_t *x) {
+    rb_node_t *y = x->right;
+    x->right = y->left;
+    if (y->left != NULL) {
+        y->left->parent = x;
+    }
+    y->parent = x->parent;
+    if (x->parent == NULL) {
+        root->node = y;
+    } else if (x == x->parent->left) {
+        x->parent->left = y;
+    } else {
+        x->parent->right = y;
+    }
+    y->left = x;
+    x->parent = y;
+}
+
+static void rotate_right(rb_root_t *root, rb_node_t *x) {
+    rb_node_t *y = x->left;
+    x->left = y->right;
+    if (y->right != NULL) {
+        y->right->parent = x;
+    }
+    y->parent = x->parent;
+    if (x->parent == NULL) {
+        root->node = y;
+    } else if (x == x->parent->right) {
+        x->parent->right = y;
+    } else {
+        x->parent->left = y;
+    }
+    y->right = x;
+    x->parent = y;
+}
+
+static inline int is_black(rb_node_t *node) {
+    return node == NULL || node->color == RB_BLACK; // NULL leaves are black
+}
+
+void rb_insert_color(rb_node_t *node, rb_root_t *root) {
+    rb_node_t *parent, *gparent, *uncle;
+    while ((parent = node->parent) != NULL && parent->color == RB_RED) {
+        gparent = parent->parent; // a red node is never the root
+        if (parent == gparent->left) {
+            uncle = gparent->right;
+            if (!is_black(uncle)) {         // case 1: recolor and move up
+                parent->color = RB_BLACK;
+                uncle->color = RB_BLACK;
+                gparent->color = RB_RED;
+                node = gparent;
+                continue;
+            }
+            if (node == parent->right) {    // case 2: rotate into case 3
+                rotate_left(root, parent);
+                node = parent;
+                parent = node->parent;
+            }
+            parent->color = RB_BLACK;       // case 3
+            gparent->color = RB_RED;
+            rotate_right(root, gparent);
+        } else {
+            uncle = gparent->left;
+            if (!is_black(uncle)) {
+                parent->color = RB_BLACK;
+                uncle->color = RB_BLACK;
+                gparent->color = RB_RED;
+                node = gparent;
+                continue;
+            }
+            if (node == parent->left) {
+                rotate_right(root, parent);
+                node = parent;
+                parent = node->parent;
+            }
+            parent->color = RB_BLACK;
+            gparent->color = RB_RED;
+            rotate_left(root, gparent);
+        }
+    }
+    root->node->color = RB_BLACK;
+}
+
+static void transplant(rb_root_t *root, rb_node_t *u, rb_node_t *v) {
+    if (u->parent == NULL) {
+        root->node = v;
+    } else if (u == u->parent->left) {
+        u->parent->left = v;
+    } else {
+        u->parent->right = v;
+    }
+    if (v != NULL) {
+        v->parent = u->parent;
+    }
+}
+
+static void erase_fixup(rb_root_t *root, rb_node_t *x, rb_node_t *parent) {
+    rb_node_t *w;
+    while (x != root->node && is_black(x)) {
+        if (x == parent->left) {
+            w = parent->right;
+            if (!is_black(w)) {
+                w->color = RB_BLACK;
+                parent->color = RB_RED;
+                rotate_left(root, parent);
+                w = parent->right;
+            }
+            if (is_black(w->left) && is_black(w->right)) {
+                w->color = RB_RED;
+                x = parent;
+                parent = x->parent;
+            } else {
+                if (is_black(w->right)) {
+                    w->left->color = RB_BLACK;
+                    w->color = RB_RED;
+                    rotate_right(root, w);
+                    w = parent->right;
+                }
+                w->color = parent->color;
+                parent->color = RB_BLACK;
+                if (w->right != NULL) {
+                    w->right->color = RB_BLACK;
+                }
+                rotate_left(root, parent);
+                x = root->node;
+                break;
+            }
+        } else {
+            w = parent->left;
+            if (!is_black(w)) {
+                w->color = RB_BLACK;
+                parent->color = RB_RED;
+                rotate_right(root, parent);
+                w = parent->left;
+            }
+            if (is_black(w->left) && is_black(w->right)) {
+                w->color = RB_RED;
+                x = parent;
+                parent = x->parent;
+            } else {
+                if (is_black(w->left)) {
+                    w->right->color = RB_BLACK;
+                    w->color = RB_RED;
+                    rotate_left(root, w);
+                    w = parent->left;
+                }
+                w->color = parent->color;
+                parent->color = RB_BLACK;
+                if (w->left != NULL) {
+                    w->left->color = RB_BLACK;
+                }
+                rotate_right(root, parent);
+                x = root->node;
+                break;
+            }
+        }
+    }
+    if (x != NULL) {
+        x->color = RB_BLACK;
+    }
+}
+
+void rb_erase(rb_node_t *z, rb_root_t *root) {
+    rb_node_t *y = z, *x, *x_parent;
+    int removed_color = y->color;
+
+    if (z->left == NULL) {
+        x = z->right;
+        x_parent = z->parent;
+        transplant(root, z, z->right);
+    } else if (z->right == NULL) {
+        x = z->left;
+        x_parent = z->parent;
+        transplant(root, z, z->left);
+    } else {
+        y = z->right; // successor: leftmost node of the right subtree
+        while (y->left != NULL) {
+            y = y->left;
+        }
+        removed_color = y->color;
+        x = y->right;
+        if (y->parent == z) {
+            x_parent = y;
+        } else {
+            x_parent = y->parent;
+            transplant(root, y, y->right);
+            y->right = z->right;
+            y->right->parent = y;
+        }
+        transplant(root, z, y);
+        y->left = z->left;
+        y->left->parent = y;
+        y->color = z->color;
+    }
+
+    if (removed_color == RB_BLACK) {
+        erase_fixup(root, x, x_parent);
+    }
+}
+
+rb_node_t *rb_first(const rb_root_t *root) {
+    rb_node_t *node = root->node;
+    if (node == NULL) {
+        return NULL;
+    }
+    while (node->left != NULL) {
+        node = node->left;
+    }
+    return node;
+}
+
+rb_node_t *rb_next(const rb_node_t *node) {
+    if (node->right != NULL) {
+        node = node->right;
+        while (node->left != NULL) {
+            node = node->left;
+        }
+        return (rb_node_t *)node;
+    }
+    while (node->parent != NULL && node == node->parent->right) {
+        node = node->parent;
+    }
+    return node->parent;
+}
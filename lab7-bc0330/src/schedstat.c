@@ -0,0 +1,231 @@
+#include <stddef.h>
+#include "allocator.h"
+#include "devfs.h"
+#include "mini_uart.h"
+#include "pid.h"
+#include "schedstat.h"
+#include "spinlock.h"
+#include "thread.h"
+#include "timer.h"
+#include "utils.h"
+#include "vfs.h"
+
+sched_hist_t rq_latency_hist;
+sched_hist_t switch_cost_hist;
+static DEFINE_SPINLOCK(hist_lock); // protects every sched_hist_t
+
+// --- histograms ---
+static int hist_bucket(unsigned long ns) {
+    ns >>= 8;
+    int bucket = 0;
+    while (ns != 0 && bucket < SCHEDSTAT_BUCKETS - 1) {
+        ns >>= 1;
+        bucket++;
+    }
+    return bucket;
+}
+
+// called with interrupts masked, from schedule() also with rq_lock held
+void schedstat_record(sched_hist_t *hist, unsigned long ticks) {
+    unsigned long ns = ticks_to_ns(ticks);
+    spin_lock(&hist_lock);
+    hist->count[hist_bucket(ns)]++;
+    hist->samples++;
+    hist->total_ns += ns;
+    if (ns > hist->max_ns) {
+        hist->max_ns = ns;
+    }
+    spin_unlock(&hist_lock);
+}
+
+void schedstat_clear_hist(sched_hist_t *hist) {
+    unsigned long flags;
+    spin_lock_irqsave(&hist_lock, flags);
+    memset((char *)hist, 0, sizeof(*hist));
+    spin_unlock_irqrestore(&hist_lock, flags);
+}
+
+void schedstat_reset(void) {
+    schedstat_clear_hist(&rq_latency_hist);
+    schedstat_clear_hist(&switch_cost_hist);
+}
+
+// --- text report ---
+void stat_puts(stat_buf_t *b, const char *s) {
+    while (*s != '\0' && b->len < b->size) {
+        b->buf[b->len++] = *s++;
+    }
+}
+
+void stat_putnum(stat_buf_t *b, unsigned long num) {
+    char digits[21];
+    int i = sizeof(digits) - 1;
+    digits[i] = '\0';
+    do {
+        digits[--i] = '0' + num % 10;
+        num /= 10;
+    } while (num != 0);
+    stat_puts(b, &digits[i]);
+}
+
+static unsigned long thread_run_ticks(thread_t *t) {
+    unsigned long run = t->run_ticks;
+    if (t->state == THREAD_RUNNING) {
+        run += read_cntpct() - t->last_arrival; // include the current slice
+    }
+    return run;
+}
+
+// user and system time in counter ticks, for times()
+void thread_cputime(thread_t *t, unsigned long *utime, unsigned long *stime) {
+    unsigned long run = thread_run_ticks(t);
+    *utime = t->user_ticks;
+    *stime = run > t->user_ticks ? run - t->user_ticks : 0;
+}
+
+static void render_thread(thread_t *t, void *arg) {
+    static const char *states[] = { "R", "Q", "D", "S" }; // running, ready, dead, sleeping
+    stat_buf_t *b = (stat_buf_t *)arg;
+    unsigned long run = thread_run_ticks(t);
+    stat_putnum(b, t->id);
+    stat_puts(b, " ");
+    stat_puts(b, states[t->state]);
+    stat_puts(b, " ");
+    stat_putnum(b, t->policy);
+    stat_puts(b, " ");
+    stat_putnum(b, t->policy == SCHED_NORMAL ? t->priority : t->rt_priority);
+    stat_puts(b, " ");
+    stat_putnum(b, ticks_to_us(run));
+    stat_puts(b, " ");
+    stat_putnum(b, ticks_to_us(t->wait_ticks));
+    stat_puts(b, " ");
+    stat_putnum(b, t->nr_voluntary);
+    stat_puts(b, " ");
+    stat_putnum(b, t->nr_involuntary);
+    stat_puts(b, " ");
+    stat_putnum(b, t->cpu);
+    stat_puts(b, " ");
+    stat_putnum(b, t->nr_migrations);
+    stat_puts(b, "\n");
+}
+
+// copies the histogram under hist_lock so the text is rendered unlocked
+void stat_render_hist(stat_buf_t *b, const char *name, sched_hist_t *hist) {
+    sched_hist_t snap;
+    unsigned long flags;
+    spin_lock_irqsave(&hist_lock, flags);
+    memcpy(&snap, hist, sizeof(snap));
+    spin_unlock_irqrestore(&hist_lock, flags);
+
+    stat_puts(b, name);
+    stat_puts(b, " (ns): samples ");
+    stat_putnum(b, snap.samples);
+    stat_puts(b, " avg ");
+    stat_putnum(b, snap.samples != 0 ? snap.total_ns / snap.samples : 0);
+    stat_puts(b, " max ");
+    stat_putnum(b, snap.max_ns);
+    stat_puts(b, "\n");
+    for (int i = 0; i < SCHEDSTAT_BUCKETS; ++i) {
+        if (snap.count[i] == 0) {
+            continue;
+        }
+        stat_puts(b, "  >= ");
+        stat_putnum(b, i == 0 ? 0 : 128UL << i);
+        stat_puts(b, ": ");
+        stat_putnum(b, snap.count[i]);
+        stat_puts(b, "\n");
+    }
+}
+
+size_t schedstat_render(char *buf, size_t size) {
+    stat_buf_t b = { buf, size, 0 };
+    stat_puts(&b, "pid state policy prio run(us) wait(us) voluntary involuntary cpu migrations\n");
+    for_each_thread(render_thread, &b);
+    stat_render_hist(&b, "runqueue latency", &rq_latency_hist);
+    stat_render_hist(&b, "context switch", &switch_cost_hist);
+    return b.len;
+}
+
+void print_sched_stats(void) {
+    char *buf = allocate(SCHEDSTAT_BUF_SIZE + 1);
+    if (buf == NULL) {
+        uart_send_string("[ERROR | SCHEDSTAT] Out of memory\r\n");
+        return;
+    }
+    buf[schedstat_render(buf, SCHEDSTAT_BUF_SIZE)] = '\0';
+    uart_send_string(buf);
+    free(buf);
+}
+
+// --- statistics devices ---
+static int write(struct file* file, const void* buf, size_t len);
+static int read(struct file* file, void* buf, size_t len);
+static int open(struct vnode* file_node, struct file** target);
+static int close(struct file* file);
+static long lseek64(struct file* file, long offset, int whence);
+static struct file_operations stat_dev_fops = {
+    .write = write,
+    .read = read,
+    .open = open,
+    .close = close,
+    .lseek64 = lseek64,
+};
+
+static const stat_dev_t *stat_dev_of(struct file* file) {
+    return ((devfs_internal_t *)file->vnode->internal)->content;
+}
+
+static int write(struct file* file, const void* buf, size_t len) {
+    stat_dev_of(file)->reset(); // whatever was written
+    return len;
+}
+
+// the report is rendered again on every read, so a reader sees current numbers
+static int read(struct file* file, void* buf, size_t len) {
+    const stat_dev_t *dev = stat_dev_of(file);
+    char *report = allocate(dev->buf_size);
+    if (report == NULL) {
+        return -1;
+    }
+    size_t size = dev->render(report, dev->buf_size);
+    size_t to_read = 0;
+    if (file->f_pos < size) {
+        to_read = (size - file->f_pos < len) ? size - file->f_pos : len;
+        memcpy(buf, report + file->f_pos, to_read);
+        file->f_pos += to_read;
+    }
+    free(report);
+    return (int)to_read;
+}
+
+static int open(struct vnode* file_node, struct file** target) {
+    return 0; // Open successful
+}
+
+static int close(struct file* file) {
+    free(file);  // Free the file handle
+    return 0; // Close successful
+}
+
+static long lseek64(struct file* file, long offset, int whence) {
+    if (whence == SEEK_END) {
+        return -1; // the report's length is only known once rendered
+    }
+    return generic_file_lseek(file, offset, whence, 0, stat_dev_of(file)->buf_size);
+}
+
+int stat_dev_register(const char *name, const stat_dev_t *dev) {
+    return devfs_register_data(name, &stat_dev_fops, (void *)dev);
+}
+
+static const stat_dev_t schedstat_dev = {
+    .render = schedstat_render,
+    .reset = schedstat_reset,
+    .buf_size = SCHEDSTAT_BUF_SIZE,
+};
+
+void schedstat_init(void) {
+    if (stat_dev_register("schedstat", &schedstat_dev) != 0) {
+        uart_send_string("[ERROR | SCHEDSTAT] Failed to create /dev/schedstat\r\n");
+    }
+}
@@ -3,7 +3,10 @@
 #include "mini_uart.h"
 #include "power_manager.h"
 #include "rootfs.h"
+#include "schedstat.h"
 #include "shell.h"
+#include "spinlock.h"
+#include "syscall.h"
 #include "utils.h"
 
 
@@ -34,9 +37,14 @@ void shell(void) {
                 uart_send_string("help     :print this help menu\r\n");
                 uart_send_string("hello    :print Hello, world!\r\n");
                 uart_send_string("info     :print hardware information\r\n");
+#ifdef CONFIG_LOCK_STAT
+                uart_send_string("lockstat :print spinlock statistics\r\n");
+#endif
                 uart_send_string("ls       :list files in rootfs\r\n");
                 uart_send_string("memAlloc :allocate memory\r\n");
                 uart_send_string("reboot   :reboot the system\r\n");
+                uart_send_string("schedstat:print scheduler statistics\r\n");
+                uart_send_string("syscallstat:print system call statistics\r\n");
             } else if (strcmp(buf, "cat")) {
                 char filename[MAX_COMMAND_LENGTH];
                 
@@ -75,6 +83,14 @@ void shell(void) {
             } else if (strcmp(buf, "info")) {
                 get_board_revision();
                 get_arm_mem();
+#ifdef CONFIG_LOCK_STAT
+            } else if (strcmp(buf, "lockstat")) {
+                print_lock_stats();
+#endif
+            } else if (strcmp(buf, "schedstat")) {
+                print_sched_stats();
+            } else if (strcmp(buf, "syscallstat")) {
+                print_syscall_stats();
             } else if (strcmp(buf, "reboot")) {
                 uart_send_string("Rebooting...\r\n");
                 reset(1000);
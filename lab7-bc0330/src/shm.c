@@ -0,0 +1,206 @@
+#include <stddef.h>
+#include "allocator.h"
+#include "mini_uart.h"
+#include "mmu.h"
+#include "shm.h"
+#include "spinlock.h"
+#include "thread.h"
+#include "utils.h"
+
+static shm_segment_t *shm_segments[SHM_MAX_SEGMENTS]; // by id, NULL once unlinked
+static DEFINE_SPINLOCK(shm_lock); // shm_segments and every refs
+
+static unsigned long shm_slot_addr(int slot) {
+    return SHM_USER_BASE + slot * SHM_MAX_SIZE;
+}
+
+// id of the linked segment called name, -1 if there is none; shm_lock held
+static int shm_find(const char *name) {
+    for (int i = 0; i < SHM_MAX_SEGMENTS; ++i) {
+        if (shm_segments[i] != NULL && strcmp(shm_segments[i]->name, name)) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+static void shm_get(shm_segment_t *seg) {
+    unsigned long flags;
+    spin_lock_irqsave(&shm_lock, flags);
+    seg->refs++;
+    spin_unlock_irqrestore(&shm_lock, flags);
+}
+
+static void shm_put(shm_segment_t *seg) {
+    unsigned long flags;
+    spin_lock_irqsave(&shm_lock, flags);
+    int refs = --seg->refs;
+    spin_unlock_irqrestore(&shm_lock, flags);
+    if (refs == 0) {
+        free(seg->mem);
+        free(seg);
+    }
+}
+
+static void shm_map(unsigned long *pgd, int slot, shm_segment_t *seg) {
+    for (size_t off = 0; off < seg->size; off += PAGE_SIZE) {
+        mappages(pgd, shm_slot_addr(slot) + off, vtop((unsigned long)seg->mem + off), PD_USR_ACCESS | PD_UNOX);
+    }
+}
+
+static void shm_unmap(unsigned long *pgd, int slot, shm_segment_t *seg) {
+    for (size_t off = 0; off < seg->size; off += PAGE_SIZE) {
+        unmappages(pgd, shm_slot_addr(slot) + off);
+    }
+}
+
+// the linked segment id asked for size bytes: id, or -1 if that is refused; shm_lock held
+static int shm_open_existing(int id, size_t size, int flags) {
+    if ((flags & SHM_CREAT) && (flags & SHM_EXCL)) {
+        return -1; // it exists
+    }
+    return size <= shm_segments[id]->size ? id : -1;
+}
+
+// returns the segment id, -1 on error
+long shm_open(const char *name, size_t size, int flags) {
+    if (name == NULL || strlen(name) == 0 || strlen(name) > SHM_NAME_LEN || size > SHM_MAX_SIZE) {
+        return -1; // Invalid argument
+    }
+    unsigned long lock_flags;
+    spin_lock_irqsave(&shm_lock, lock_flags);
+    int id = shm_find(name);
+    if (id >= 0) {
+        id = shm_open_existing(id, size, flags);
+        spin_unlock_irqrestore(&shm_lock, lock_flags);
+        return id;
+    }
+    spin_unlock_irqrestore(&shm_lock, lock_flags);
+    if (!(flags & SHM_CREAT) || size == 0) {
+        return -1; // no such segment
+    }
+
+    shm_segment_t *seg = allocate(sizeof(shm_segment_t));
+    size_t pages = (size + PAGE_SIZE - 1) / PAGE_SIZE;
+    void *mem = allocate(pages * PAGE_SIZE);
+    if (seg == NULL || mem == NULL) {
+        uart_send_string("[ERROR | SHM] Out of memory\r\n");
+        if (seg != NULL) {
+            free(seg);
+        }
+        if (mem != NULL) {
+            free(mem);
+        }
+        return -1;
+    }
+    memset((char *)mem, 0, pages * PAGE_SIZE);
+    strncpy(seg->name, name, SHM_NAME_LEN + 1);
+    seg->mem = mem;
+    seg->size = pages * PAGE_SIZE;
+    seg->refs = 1; // the name
+
+    spin_lock_irqsave(&shm_lock, lock_flags);
+    int created = 0;
+    id = shm_find(name);
+    if (id >= 0) { // somebody created it while we allocated
+        id = shm_open_existing(id, size, flags);
+    } else {
+        for (int i = 0; i < SHM_MAX_SEGMENTS; ++i) {
+            if (shm_segments[i] == NULL) {
+                shm_segments[i] = seg;
+                id = i;
+                created = 1;
+                break;
+            }
+        }
+    }
+    spin_unlock_irqrestore(&shm_lock, lock_flags);
+    if (!created) {
+        free(mem);
+        free(seg);
+    }
+    return id;
+}
+
+// returns the user address of the segment, -1 on error
+long shm_attach(int id) {
+    thread_t *self = current_thread;
+    int slot = -1;
+    for (int i = 0; i < SHM_ATTACH_MAX; ++i) {
+        if (self->shm[i] == NULL) {
+            slot = i;
+            break;
+        }
+    }
+    if (id < 0 || id >= SHM_MAX_SEGMENTS || slot < 0) {
+        return -1;
+    }
+    unsigned long flags;
+    spin_lock_irqsave(&shm_lock, flags);
+    shm_segment_t *seg = shm_segments[id];
+    if (seg != NULL) {
+        seg->refs++; // now it can't go away under us
+    }
+    spin_unlock_irqrestore(&shm_lock, flags);
+    if (seg == NULL) {
+        return -1; // unlinked meanwhile
+    }
+    shm_map(self->pgd, slot, seg);
+    self->shm[slot] = seg;
+    return shm_slot_addr(slot);
+}
+
+int shm_detach(unsigned long addr) {
+    thread_t *self = current_thread;
+    for (int i = 0; i < SHM_ATTACH_MAX; ++i) {
+        if (self->shm[i] != NULL && shm_slot_addr(i) == addr) {
+            shm_segment_t *seg = self->shm[i];
+            shm_unmap(self->pgd, i, seg);
+            self->shm[i] = NULL;
+            shm_put(seg);
+            return 0;
+        }
+    }
+    return -1; // nothing attached there
+}
+
+// the name goes away now, the memory with the last detach
+int shm_unlink(const char *name) {
+    if (name == NULL) {
+        return -1;
+    }
+    unsigned long flags;
+    spin_lock_irqsave(&shm_lock, flags);
+    int id = shm_find(name);
+    shm_segment_t *seg = id >= 0 ? shm_segments[id] : NULL;
+    if (seg != NULL) {
+        shm_segments[id] = NULL;
+    }
+    spin_unlock_irqrestore(&shm_lock, flags);
+    if (seg == NULL) {
+        return -1; // no such segment
+    }
+    shm_put(seg);
+    return 0;
+}
+
+// fork: the child shares every segment the parent has attached, at the same address
+void shm_fork(thread_t *child) {
+    for (int i = 0; i < SHM_ATTACH_MAX; ++i) {
+        if (child->shm[i] != NULL) { // copied from the parent
+            shm_get(child->shm[i]);
+            shm_map(child->pgd, i, child->shm[i]);
+        }
+    }
+}
+
+// exec and exit
+void shm_release(thread_t *t) {
+    for (int i = 0; i < SHM_ATTACH_MAX; ++i) {
+        if (t->shm[i] != NULL) {
+            shm_unmap(t->pgd, i, t->shm[i]);
+            shm_put(t->shm[i]);
+            t->shm[i] = NULL;
+        }
+    }
+}
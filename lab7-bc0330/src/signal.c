@@ -0,0 +1,205 @@
+#include <stddef.h>
+#include "exception_handler.h"
+#include "fpsimd.h"
+#include "mini_uart.h"
+#include "signal.h"
+#include "spinlock.h"
+#include "thread.h"
+#include "utils.h"
+
+#define USER_STACK_BOTTOM 0xFFFFFFFFB000UL // 4 pages mapped by thread_create() and fork
+#define USER_STACK_TOP    0xFFFFFFFFF000UL
+
+#define SIGRETURN_INSN_MOV 0xd2800148 // mov x8, #10
+#define SIGRETURN_INSN_SVC 0xd4000001 // svc #0
+
+static DEFINE_SPINLOCK(sig_lock); // sig_pending and sig_blocked of every thread
+
+void signal_init(thread_t *t) {
+    t->sig_pending = 0;
+    t->sig_blocked = 0;
+    for (int i = 0; i < NSIG; ++i) {
+        t->sig_handlers[i] = SIG_DFL;
+    }
+}
+
+// the new program can't have handlers at the old addresses; ignored stays ignored
+void signal_exec(thread_t *t) {
+    for (int i = 0; i < NSIG; ++i) {
+        if (t->sig_handlers[i] != SIG_IGN) {
+            t->sig_handlers[i] = SIG_DFL;
+        }
+    }
+}
+
+/*
+    Kernel address of the user stack range [vaddr, vaddr + size), NULL if
+    it isn't entirely on the stack. Frames are accessed through it, like
+    sys_mbox_call() does, so a bad sp_el0 can't fault in the kernel.
+*/
+static void *user_stack_ptr(thread_t *t, unsigned long vaddr, size_t size) {
+    if (vaddr < USER_STACK_BOTTOM || vaddr > USER_STACK_TOP || size > USER_STACK_TOP - vaddr) {
+        return NULL;
+    }
+    return (char *)t->usr_stack_base + (vaddr - USER_STACK_BOTTOM);
+}
+
+int send_signal(thread_t *t, int sig) {
+    if (sig <= 0 || sig >= NSIG) {
+        return -1; // Invalid signal
+    }
+    unsigned long flags;
+    spin_lock_irqsave(&sig_lock, flags);
+    if (t->sig_handlers[sig] == SIG_IGN) {
+        spin_unlock_irqrestore(&sig_lock, flags);
+        return 0; // discarded right away
+    }
+    t->sig_pending |= sigmask(sig);
+    int deliverable = !(t->sig_blocked & sigmask(sig));
+    spin_unlock_irqrestore(&sig_lock, flags);
+    if (deliverable) {
+        thread_wakeup(t); // cut a sleep short so it sees the signal soon
+    }
+    return 0;
+}
+
+// returns the previous handler, or SIG_DFL for an invalid signal
+void *signal_set_handler(int sig, void *handler) {
+    if (sig <= 0 || sig >= NSIG) {
+        return SIG_DFL;
+    }
+    void *old = current_thread->sig_handlers[sig];
+    current_thread->sig_handlers[sig] = handler;
+    if (handler == SIG_IGN) {
+        unsigned long flags;
+        spin_lock_irqsave(&sig_lock, flags);
+        current_thread->sig_pending &= ~sigmask(sig); // pending ones are discarded too
+        spin_unlock_irqrestore(&sig_lock, flags);
+    }
+    return old;
+}
+
+// set NULL only reads the mask into oldset
+int signal_procmask(int how, const unsigned long *set, unsigned long *oldset) {
+    thread_t *t = current_thread;
+    unsigned long old = t->sig_blocked; // only we change our own mask
+    unsigned long blocked = old;
+    if (set != NULL) {
+        switch (how) {
+            case SIG_BLOCK:
+                blocked |= *set;
+                break;
+            case SIG_UNBLOCK:
+                blocked &= ~*set;
+                break;
+            case SIG_SETMASK:
+                blocked = *set;
+                break;
+            default:
+                return -1; // Invalid argument
+        }
+    }
+    if (oldset != NULL) {
+        *oldset = old;
+    }
+
+    unsigned long flags;
+    spin_lock_irqsave(&sig_lock, flags);
+    t->sig_blocked = blocked;
+    t->sig_blocked &= ~(sigmask(SIGKILL) | sigmask(0)); // can't be blocked
+    spin_unlock_irqrestore(&sig_lock, flags);
+    return 0;
+}
+
+// lowest pending unblocked signal, taken off the pending mask; 0 if none
+static int dequeue_signal(thread_t *t) {
+    unsigned long flags;
+    spin_lock_irqsave(&sig_lock, flags);
+    unsigned long ready = t->sig_pending & ~t->sig_blocked;
+    int sig = 0;
+    if (ready != 0) {
+        sig = __builtin_ctzl(ready);
+        t->sig_pending &= ~sigmask(sig);
+    }
+    spin_unlock_irqrestore(&sig_lock, flags);
+    return sig;
+}
+
+static void setup_frame(thread_t *t, trapframe_t *tf, int sig, void *handler) {
+    unsigned long sp = (tf->sp_el0 - sizeof(struct sigframe)) & ~0xFUL;
+    struct sigframe *frame = user_stack_ptr(t, sp, sizeof(struct sigframe));
+    if (frame == NULL) {
+        uart_send_string("[ERROR | SIGNAL] No room for the signal frame\r\n");
+        do_exit(128 + sig);
+    }
+
+    memcpy(&frame->tf, tf, sizeof(trapframe_t));
+    frame->blocked = t->sig_blocked;
+    frame->fp_valid = 0;
+    if (t->fpsimd != NULL) { // the handler may clobber the V registers
+        if (fpsimd_owner[smp_processor_id()] == t) {
+            fpsimd_save_state(t->fpsimd);
+        }
+        memcpy(&frame->fp, t->fpsimd, sizeof(struct fpsimd_state));
+        frame->fp_valid = 1;
+    }
+    // caches are off (boot.S), so the stores need no maintenance before EL0 runs them
+    frame->trampoline[0] = SIGRETURN_INSN_MOV;
+    frame->trampoline[1] = SIGRETURN_INSN_SVC;
+
+    unsigned long flags;
+    spin_lock_irqsave(&sig_lock, flags);
+    t->sig_blocked |= sigmask(sig) & ~sigmask(SIGKILL); // no nesting of the same signal
+    spin_unlock_irqrestore(&sig_lock, flags);
+
+    tf->x[0] = sig;
+    tf->x[30] = sp + offsetof(struct sigframe, trampoline); // the handler returns into sigreturn
+    tf->sp_el0 = sp;
+    tf->elr_el1 = (unsigned long)handler;
+    tf->spsr_el1 = 0; // EL0t, interrupts enabled
+}
+
+// called by exit_to_user() when signal_pending(): deliver one signal
+void do_signal(trapframe_t *tf) {
+    thread_t *t = current_thread;
+    while (1) {
+        int sig = dequeue_signal(t);
+        if (sig == 0) {
+            return;
+        }
+        void *handler = t->sig_handlers[sig];
+        if (handler == SIG_IGN) {
+            continue;
+        }
+        if (handler == SIG_DFL) {
+            do_exit(128 + sig); // exit status as a shell reports it
+        }
+        setup_frame(t, tf, sig, handler);
+        return; // the rest are delivered after its sigreturn
+    }
+}
+
+// sigreturn: sp_el0 is back where setup_frame() left it
+void do_sigreturn(trapframe_t *tf) {
+    thread_t *t = current_thread;
+    struct sigframe *frame = user_stack_ptr(t, tf->sp_el0, sizeof(struct sigframe));
+    if (frame == NULL) {
+        uart_send_string("[ERROR | SIGNAL] Bad signal frame\r\n");
+        do_exit(128 + SIGKILL);
+    }
+
+    unsigned long blocked = frame->blocked;
+    memcpy(tf, &frame->tf, sizeof(trapframe_t));
+    tf->spsr_el1 &= ~0x3FFUL; // EL0t with interrupts enabled, whatever the frame says
+    if (frame->fp_valid && t->fpsimd != NULL) {
+        memcpy(t->fpsimd, &frame->fp, sizeof(struct fpsimd_state));
+        if (fpsimd_owner[smp_processor_id()] == t) {
+            fpsimd_load_state(t->fpsimd);
+        }
+    }
+
+    unsigned long flags;
+    spin_lock_irqsave(&sig_lock, flags);
+    t->sig_blocked = blocked & ~(sigmask(SIGKILL) | sigmask(0));
+    spin_unlock_irqrestore(&sig_lock, flags);
+}
@@ -0,0 +1,118 @@
+#include <stddef.h>
+#include "exception_handler.h"
+#include "mini_uart.h"
+#include "softirq.h"
+#include "spinlock.h"
+#include "thread.h"
+#include "wait.h"
+
+static void (*softirq_vec[NR_SOFTIRQS])(void);
+static volatile unsigned long softirq_pending[NR_CPUS]; // bit nr: softirq nr raised
+static int softirq_running[NR_CPUS];                    // softirqs are being run on this CPU
+static wait_queue_head_t ksoftirqd_wait;
+
+static struct tasklet_struct *tasklet_vec[NR_CPUS];     // scheduled tasklets, LIFO
+static DEFINE_SPINLOCK(tasklet_lock);
+
+void open_softirq(int nr, void (*action)(void)) {
+    softirq_vec[nr] = action;
+}
+
+void raise_softirq(int nr) {
+    unsigned long daif = disable_interrupt();
+    softirq_pending[smp_processor_id()] |= 1UL << nr;
+    enable_interrupt(daif);
+}
+
+int in_softirq(void) {
+    return softirq_running[smp_processor_id()];
+}
+
+/*
+    Run the pending softirqs. Called with interrupts masked; they are
+    unmasked around the handlers and masked again on return.
+*/
+static void do_softirq(void) {
+    int cpu = smp_processor_id();
+    if (softirq_running[cpu]) {
+        return; // interrupted a softirq: its loop picks up the new bits
+    }
+    softirq_running[cpu] = 1;
+    for (int restart = 0; restart < MAX_SOFTIRQ_RESTART; ++restart) {
+        unsigned long pending = softirq_pending[cpu];
+        if (pending == 0) {
+            break;
+        }
+        softirq_pending[cpu] = 0;
+        asm volatile ("msr daifclr, 2\n" ::: "memory");
+        for (int nr = 0; nr < NR_SOFTIRQS; ++nr) {
+            if ((pending & (1UL << nr)) && softirq_vec[nr] != NULL) {
+                softirq_vec[nr]();
+            }
+        }
+        asm volatile ("msr daifset, 2\n" ::: "memory");
+    }
+    softirq_running[cpu] = 0;
+    if (softirq_pending[cpu] != 0) {
+        wake_up(&ksoftirqd_wait); // still busy: don't starve the threads
+    }
+}
+
+// last step of the outermost interrupt handler
+void irq_exit(void) {
+    if (softirq_pending[smp_processor_id()] != 0) {
+        do_softirq();
+    }
+}
+
+static void ksoftirqd(void) {
+    while (1) {
+        wait_event(ksoftirqd_wait, softirq_pending[smp_processor_id()] != 0);
+        unsigned long daif = disable_interrupt();
+        do_softirq();
+        enable_interrupt(daif);
+    }
+}
+
+// --- tasklets ---
+void tasklet_init(struct tasklet_struct *t, void (*func)(unsigned long data), unsigned long data) {
+    t->next = NULL;
+    t->state = 0;
+    t->func = func;
+    t->data = data;
+}
+
+void tasklet_schedule(struct tasklet_struct *t) {
+    unsigned long flags;
+    spin_lock_irqsave(&tasklet_lock, flags);
+    if (!(t->state & TASKLET_STATE_SCHED)) { // otherwise it is going to run anyway
+        t->state |= TASKLET_STATE_SCHED;
+        t->next = tasklet_vec[smp_processor_id()];
+        tasklet_vec[smp_processor_id()] = t;
+    }
+    spin_unlock_irqrestore(&tasklet_lock, flags);
+    raise_softirq(TASKLET_SOFTIRQ);
+}
+
+static void tasklet_action(void) {
+    unsigned long flags;
+    spin_lock_irqsave(&tasklet_lock, flags);
+    struct tasklet_struct *list = tasklet_vec[smp_processor_id()];
+    tasklet_vec[smp_processor_id()] = NULL;
+    spin_unlock_irqrestore(&tasklet_lock, flags);
+
+    while (list != NULL) {
+        struct tasklet_struct *t = list;
+        list = t->next;
+        spin_lock_irqsave(&tasklet_lock, flags);
+        t->state &= ~TASKLET_STATE_SCHED; // may be scheduled again from here on
+        spin_unlock_irqrestore(&tasklet_lock, flags);
+        t->func(t->data);
+    }
+}
+
+void softirq_init(void) {
+    init_waitqueue_head(&ksoftirqd_wait);
+    open_softirq(TASKLET_SOFTIRQ, tasklet_action);
+    thread_create(ksoftirqd, MEDIUM_PRIORITY, NULL, 0);
+}
@@ -0,0 +1,100 @@
+#include <stddef.h>
+#include "mini_uart.h"
+#include "spinlock.h"
+#include "timer.h"
+
+void spin_lock_init(spinlock_t *lock, const char *name) {
+    lock->raw.owner = 0;
+    lock->raw.next = 0;
+#ifdef CONFIG_LOCK_STAT
+    lock->name = name;
+    lock->stat_next = NULL;
+    lock->registered = 0;
+    lock->acquired = 0;
+    lock->contended = 0;
+    lock->wait_ticks = 0;
+    lock->max_wait = 0;
+    lock->hold_ticks = 0;
+    lock->max_hold = 0;
+    lock->hold_start = 0;
+#endif
+}
+
+#ifdef CONFIG_LOCK_STAT
+/*
+    Every lock joins the stat list the first time it is taken, so locks
+    defined statically with DEFINE_SPINLOCK() need no registration call.
+*/
+static arch_spinlock_t stat_list_lock;
+static spinlock_t *stat_list = NULL;
+
+static void lock_stat_register(spinlock_t *lock) {
+    arch_spin_lock(&stat_list_lock);
+    if (!lock->registered) {
+        lock->stat_next = stat_list;
+        stat_list = lock;
+        lock->registered = 1;
+    }
+    arch_spin_unlock(&stat_list_lock);
+}
+
+static void lock_stat_acquired(spinlock_t *lock) {
+    // only the owner writes the counters, so no extra locking is needed
+    lock->acquired++;
+    lock->hold_start = read_cntpct();
+    if (!lock->registered) {
+        lock_stat_register(lock);
+    }
+}
+
+void lock_stat_acquire(spinlock_t *lock) {
+    if (!arch_spin_trylock(&lock->raw)) {
+        unsigned long start = read_cntpct();
+        arch_spin_lock(&lock->raw);
+        unsigned long wait = read_cntpct() - start;
+        lock->contended++;
+        lock->wait_ticks += wait;
+        if (wait > lock->max_wait) {
+            lock->max_wait = wait;
+        }
+    }
+    lock_stat_acquired(lock);
+}
+
+int lock_stat_tryacquire(spinlock_t *lock) {
+    if (!arch_spin_trylock(&lock->raw)) {
+        return 0;
+    }
+    lock_stat_acquired(lock);
+    return 1;
+}
+
+void lock_stat_release(spinlock_t *lock) {
+    unsigned long hold = read_cntpct() - lock->hold_start;
+    lock->hold_ticks += hold;
+    if (hold > lock->max_hold) {
+        lock->max_hold = hold;
+    }
+    arch_spin_unlock(&lock->raw);
+}
+
+void print_lock_stats(void) {
+    uart_send_string("name: acquired contended wait-max(us) wait-total(us) hold-max(us) hold-total(us)\r\n");
+    for (spinlock_t *lock = stat_list; lock != NULL; lock = lock->stat_next) {
+        uart_send_string((char *)(lock->name != NULL ? lock->name : "(anon)"));
+        uart_send_string(": ");
+        uart_send_num(lock->acquired, "dec");
+        uart_send_string(" ");
+        uart_send_num(lock->contended, "dec");
+        uart_send_string(" ");
+        uart_send_num(ticks_to_us(lock->max_wait), "dec");
+        uart_send_string(" ");
+        uart_send_num(ticks_to_us(lock->wait_ticks), "dec");
+        uart_send_string(" ");
+        uart_send_num(ticks_to_us(lock->max_hold), "dec");
+        uart_send_string(" ");
+        uart_send_num(ticks_to_us(lock->hold_ticks), "dec");
+        uart_send_string("\r\n");
+    }
+}
+#endif
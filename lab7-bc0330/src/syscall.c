@@ -1,19 +1,27 @@
 #include "allocator.h"
 #include "exception_handler.h"
+#include "fpsimd.h"
+#include "futex.h"
 #include "framebufferfs.h"
 #include "initramfs.h"
 #include "mailbox.h"
 #include "mini_uart.h"
 #include "mmu.h"
+#include "pipe.h"
+#include "poll.h"
+#include "pid.h"
 #include "rootfs.h"
+#include "schedstat.h"
+#include "shm.h"
+#include "signal.h"
 #include "syscall.h"
 #include "thread.h"
+#include "timer.h"
+#include "uring.h"
 #include "utils.h"
 #include "vfs.h"
 #include <stddef.h>
 
-void *signal_handler[10] = {NULL};
-
 void sys_get_pid(trapframe_t *tf) {
     tf->x[0] = current_thread->id;
 }
@@ -22,7 +30,12 @@ void sys_uart_read(trapframe_t *tf) {
     char *buf = (char *)tf->x[0];
     size_t size = tf->x[1];
     for (size_t i = 0; i < size; ++i) {
-        buf[i] = uart_recv();
+        int c = uart_getc(); // sleeps until the RX interrupt delivers data
+        if (c < 0) { // killed or signalled: what we have so far
+            tf->x[0] = i > 0 ? i : -1;
+            return;
+        }
+        buf[i] = c;
     }
     tf->x[0] = size; // return the number of bytes read
 }
@@ -36,8 +49,19 @@ void sys_uart_write(trapframe_t *tf) {
     tf->x[0] = size; // return the number of bytes written
 }
 
+/*
+    memcpy() a page at a time with a preemption point in between, so a big
+    copy doesn't hold off the rest of the system for its full length.
+*/
+static void copy_resched(void *dest, const void *src, size_t size) {
+    for (size_t done = 0; done < size; done += PAGE_SIZE) {
+        size_t len = size - done < PAGE_SIZE ? size - done : PAGE_SIZE;
+        memcpy((char *)dest + done, (const char *)src + done, len);
+        cond_resched();
+    }
+}
+
 void sys_exec(trapframe_t *tf) {
-    unsigned long daif = disable_interrupt();
     uart_send_string("[SYSCALL] exec\r\n");
     char *filename = (char *)tf->x[0];
     int prog_size;
@@ -47,13 +71,16 @@ void sys_exec(trapframe_t *tf) {
 
     if (vfs_open(filename, O_RDONLY, &entry) != 0) {
         uart_send_string("[ERROR] File not found\r\n");
-        enable_interrupt(daif);
         return; // File not found
     }
     prog_size = ((initramfs_internal_t *)entry->vnode->internal)->size;
 
     memset((char *)cur_thread->usr_stack_base, 0, 4 * thread_stack_size);
     free(cur_thread->user_prog); // Free the old user program
+    fpsimd_release(cur_thread); // the new program starts with clean FP/SIMD registers
+    uring_release(cur_thread);  // and without the old program's rings
+    shm_release(cur_thread);    // or shared memory
+    signal_exec(cur_thread);    // or its signal handlers
     memset((char *)tf, 0, sizeof(trapframe_t)); // Clear the trap frame
 
     cur_thread->prog_size = prog_size; // Set the new program size
@@ -62,11 +89,14 @@ void sys_exec(trapframe_t *tf) {
         uart_send_string("Memory allocation failed for user program\n");
         return; // Memory allocation failed
     }
-    if (vfs_read(entry, cur_thread->user_prog, prog_size) != prog_size) {
-        uart_send_string("[ERROR] Failed to read user program\r\n");
-        vfs_close(entry); // Close the file after reading
-        enable_interrupt(daif);
-        return; // Read error
+    for (int done = 0; done < prog_size; done += PAGE_SIZE) { // a page at a time, see copy_resched()
+        int len = prog_size - done < PAGE_SIZE ? prog_size - done : PAGE_SIZE;
+        if (vfs_read(entry, (char *)cur_thread->user_prog + done, len) != len) {
+            uart_send_string("[ERROR] Failed to read user program\r\n");
+            vfs_close(entry); // Close the file after reading
+            return; // Read error
+        }
+        cond_resched();
     }
     vfs_close(entry); // Close the file after reading
     // memcpy(cur_thread->user_prog, entry, prog_size); // Copy the new user program to the thread
@@ -79,50 +109,81 @@ void sys_exec(trapframe_t *tf) {
     tf->sp_el0 = 0xFFFFFFFFF000; // Set the stack pointer to the top of the user stack
     tf->elr_el1 = 0; // Set the entry point
     tf->spsr_el1 = 0; // Set the SPSR to 0
-    enable_interrupt(daif); // Enable interrupts
-
 }
 
 void sys_fork(trapframe_t *tf) {
-    uart_send_string("[SYSCALL] fork\r\n");
-    thread_t *child_thread = allocate(sizeof(thread_t));
+    // uart_send_string("[SYSCALL] fork\r\n");
+    thread_t *child_thread = thread_alloc(); // thread_t and both stacks
+    if (child_thread == NULL) {
+        tf->x[0] = -1;
+        return;
+    }
+    void *usr_stack_base = child_thread->usr_stack_base;
+    void *kernel_stack_base = child_thread->kernel_stack_base;
 
     *child_thread = *current_thread; // Copy the current thread's context
-    child_thread->id = counter++; // Assign a unique ID to the child thread
-    child_thread->signal = 0;
+    child_thread->usr_stack_base = usr_stack_base;
+    child_thread->kernel_stack_base = kernel_stack_base;
+    child_thread->id = alloc_pid(); // Assign a unique ID to the child thread
+    if (child_thread->id == PID_INVALID) {
+        thread_free(child_thread);
+        tf->x[0] = -1;
+        return;
+    }
+    if (fpsimd_fork(child_thread, current_thread) != 0) {
+        free_pid(child_thread->id);
+        thread_free(child_thread);
+        tf->x[0] = -1;
+        return;
+    }
+    child_thread->state = THREAD_READY;
+    child_thread->sig_pending = 0; // handlers and the blocked mask are inherited
+    child_thread->exit_code = 0;
+    child_thread->killed = 0;
+    child_thread->preempt_count = 0; // it leaves through restore_context(), not syscall_handler()
+    child_thread->children = NULL;
+    child_thread->ring = NULL; // the ring page isn't mapped into the child
+    init_waitqueue_head(&child_thread->wait_child);
+    schedstat_clear(child_thread);
 
     child_thread->pgd = allocate(PAGE_SIZE); // Allocate a new page directory for the child thread
     memset((char *)child_thread->pgd, 0, PAGE_SIZE); // Initialize the page directory to zero
 
     // copy the parent's user stack to the child
-    child_thread->usr_stack_base = allocate(4 * PAGE_SIZE); // Allocate stack for the child thread
     child_thread->usr_stack = child_thread->usr_stack_base + 4 * PAGE_SIZE; // Set the stack pointer to the top of the stack
-    memcpy(child_thread->usr_stack_base, current_thread->usr_stack_base, 4 * PAGE_SIZE); // Copy the parent's stack to the child
+    copy_resched(child_thread->usr_stack_base, current_thread->usr_stack_base, 4 * PAGE_SIZE); // Copy the parent's stack to the child
     for (int i = 0; i < 4; ++i) {
         mappages(child_thread->pgd, 0xFFFFFFFFB000 + i * PAGE_SIZE, 
             vtop((unsigned long)child_thread->usr_stack_base + i * PAGE_SIZE), PD_USR_ACCESS); // Map the user stack pages
     }
 
     // copy the parent's kernel stack to the child
-    child_thread->kernel_stack_base = allocate(thread_stack_size); // Allocate kernel stack for the child thread
     child_thread->kernel_stack = child_thread->kernel_stack_base + thread_stack_size - sizeof(trapframe_t); // Set the kernel stack pointer to the top of the stack
     trapframe_t *child_tf = (trapframe_t *)child_thread->kernel_stack; // Set the child thread's trapframe
     memcpy(child_tf, tf, sizeof(trapframe_t)); // Copy the parent's trapframe to the child
 
     child_thread->user_prog = allocate(current_thread->prog_size); // Allocate memory for the child thread's user program
-    memcpy(child_thread->user_prog, current_thread->user_prog, current_thread->prog_size); // Copy the parent's user program to the child
+    copy_resched(child_thread->user_prog, current_thread->user_prog, current_thread->prog_size); // Copy the parent's user program to the child
     for (size_t i = 0; i < child_thread->prog_size; i += PAGE_SIZE) {
         unsigned long paddr = vtop((unsigned long)child_thread->user_prog + i);
         mappages(child_thread->pgd, i, paddr, PD_USR_ACCESS); // Map the user program pages
     }
 
     setup_thread_peripherals(child_thread->pgd); // Set up the thread's peripherals
+    shm_fork(child_thread); // same segments at the same addresses
 
     // --- vfs setup ---
     child_thread->cwd = NULL;
+    spin_lock_init(&child_thread->files_lock, "files");
+    unsigned long flags;
+    spin_lock_irqsave(&current_thread->files_lock, flags); // a ring's poller may change slots
     for (int i = 0; i < MAX_FD; ++i) {
-        child_thread->files_table[i] = NULL; // Initialize the file descriptors table to NULL
+        child_thread->files_table[i] = current_thread->files_table[i];
+        if (child_thread->files_table[i] != NULL) { // shared with the parent, position included
+            vfs_dup(child_thread->files_table[i]);
+        }
     }
+    spin_unlock_irqrestore(&current_thread->files_lock, flags);
 
     child_tf->x[0] = 0; // Set the return value to 0 for the child thread
 
@@ -133,12 +194,20 @@ void sys_fork(trapframe_t *tf) {
     child_thread->context[11] = (unsigned long)restore_context; // Set the function to execute in the context
     child_thread->context[10] = (unsigned long)child_thread->kernel_stack_base; // Set the stack pointer in the context
 
+    spin_lock_irqsave(&tasklist_lock, flags);
+    child_thread->parent = current_thread; // link into the parent's children
+    child_thread->sibling = current_thread->children;
+    current_thread->children = child_thread;
+    spin_unlock_irqrestore(&tasklist_lock, flags);
+
+    attach_pid(child_thread);
     thread_enqueue(child_thread); // Add the child thread to the run 
     tf->x[0] = child_thread->id; // Set the return value to the child thread's ID for the parent thread
 }
 
 void restore_context(void) {
     asm volatile (
+        "bl schedule_tail\n" // release the run queue lock held by switch_to's caller
         "ldp x0, x1, [sp, 16 * 16]\n"
         "msr elr_el1, x0\n"
         "msr spsr_el1, x1\n"
@@ -165,8 +234,8 @@ void restore_context(void) {
 }
 
 void sys_exit(trapframe_t *tf) {
-    uart_send_string("[SYSCALL] exit\r\n");
-    thread_exit();
+    // uart_send_string("[SYSCALL] exit\r\n");
+    do_exit(tf->x[0]); // exit code for the parent's waitpid()
 }
 
 void sys_mbox_call(trapframe_t *tf) {
@@ -176,7 +245,6 @@ void sys_mbox_call(trapframe_t *tf) {
 
 void sys_kill(trapframe_t *tf) {
     uart_send_string("[SYSCALL] kill\r\n");
-    unsigned long daif = disable_interrupt();
     int pid = tf->x[0];
     int status = tf->x[1];
     thread_t *target_thread = NULL;
@@ -189,94 +257,236 @@ void sys_kill(trapframe_t *tf) {
     }
     // while (1);
     if (target_thread != NULL) {
-        thread_kill(target_thread, status); // Call the corrected thread_kill
-
-        // If we killed the current thread, we must schedule away from it.
-        if (target_thread == current_thread) {
-            enable_interrupt(daif); // Must enable before calling schedule
-            schedule();             // schedule() will switch context
-            // Code should not reach here after schedule() if killing self
-            uart_send_string("Error: Returned after schedule() in self-kill\r\n");
-            while(1); // Safety loop
-        }
-        // If killing another thread, just continue execution in the current thread.
+        thread_kill(target_thread, status); // does not return when killing self
     } else {
         uart_send_string("Thread not found or cannot kill\r\n");
         // Set error return code? tf->x[0] = -ESRCH; (or similar)
     }
-    enable_interrupt(daif);
 }
 
 thread_t *find_thread_by_id(int id) {
-    for (int i = HIGH_PRIORITY; i >= LOW_PRIORITY; --i) {
-        thread_t *thread = run_queue[i].head;
-        while (thread != NULL) {
-            if (thread->id == id) {
-                return thread;
-            }
-            thread = thread->next;
-        }
-    }
-    return NULL;
-}
-
-void default_sigkill_handler(int unused) {
-    thread_kill(current_thread, 0);
+    return find_thread_by_pid(id); // running and blocked threads too
 }
 
 void sys_signal(trapframe_t *tf) {
     int signum = tf->x[0];
-    signal_handler[signum] = (void *)tf->x[1]; // Set the signal handler
+    void *handler = (void *)tf->x[1]; // SIG_DFL, SIG_IGN or a user function
+    tf->x[0] = (unsigned long)signal_set_handler(signum, handler); // Return the previous handler
 }
 
 void sys_sigkill(trapframe_t *tf) {
-    uart_send_string("[SYSCALL] sigkill\r\n");
-    unsigned long daif = disable_interrupt();
     int pid = tf->x[0];
+    int signum = tf->x[1];
+    thread_t *target_thread = find_thread_by_id(pid);
+    if (target_thread == NULL) {
+        uart_send_string("[ERROR | SIGKILL] Thread not found\r\n");
+        tf->x[0] = -1;
+        return;
+    }
+    tf->x[0] = send_signal(target_thread, signum);
+}
+
+void sys_sigreturn(trapframe_t *tf) {
+    do_sigreturn(tf); // the whole trapframe, x0 included, comes from the signal frame
+}
+
+void sys_sigprocmask(trapframe_t *tf) {
+    int how = tf->x[0];                               // SIG_BLOCK, SIG_UNBLOCK or SIG_SETMASK
+    const unsigned long *set = (const unsigned long *)tf->x[1]; // NULL: only query
+    unsigned long *oldset = (unsigned long *)tf->x[2]; // may be NULL
+    tf->x[0] = signal_procmask(how, set, oldset);
+}
+
+void sys_setpriority(trapframe_t *tf) {
+    int pid = tf->x[0];
+    int priority = tf->x[1];
     thread_t *target_thread = NULL;
 
-    if (pid == current_thread->id) {
-        uart_send_string("Killing current thread (self)\r\n");
+    if (pid == 0 || pid == current_thread->id) {
         target_thread = current_thread;
     } else {
-        uart_send_string("Attempting to kill thread with PID: ");
-        uart_send_num(pid, "hex");
-        uart_send_string("\r\n");
         target_thread = find_thread_by_id(pid);
     }
+    if (target_thread == NULL) {
+        uart_send_string("[ERROR | SETPRIORITY] Thread not found\r\n");
+        tf->x[0] = -1;
+        return;
+    }
+    tf->x[0] = thread_set_priority(target_thread, priority);
+}
 
-    if (target_thread != NULL) {
-        target_thread->signal = tf->x[1]; // Set the signal for the target thread
+void sys_nice(trapframe_t *tf) {
+    int inc = tf->x[0];
+    int priority = current_thread->priority - inc; // positive nice lowers priority
+    if (priority < LOW_PRIORITY) {
+        priority = LOW_PRIORITY;
+    } else if (priority > HIGH_PRIORITY) {
+        priority = HIGH_PRIORITY;
+    }
+    thread_set_priority(current_thread, priority);
+    tf->x[0] = priority; // Return the new priority
+}
+
+void sys_nanosleep(trapframe_t *tf) {
+    const struct timespec *req = (const struct timespec *)tf->x[0];
+    struct timespec *rem = (struct timespec *)tf->x[1];
+    if (req == NULL || req->tv_sec < 0 || req->tv_nsec < 0 || req->tv_nsec >= 1000000000) {
+        tf->x[0] = -1; // Invalid argument
+        return;
+    }
+
+    unsigned long frq = read_cntfrq();
+    unsigned long ticks = req->tv_sec * frq + req->tv_nsec * frq / 1000000000;
+    current_thread->state = THREAD_WAITING; // off the run queue until the timer fires
+    unsigned long left = schedule_timeout(ticks);
+    if (left == 0) {
+        tf->x[0] = 0;
+        return;
+    }
+    if (rem != NULL) { // woken early: report the remaining time
+        rem->tv_sec = left / frq;
+        rem->tv_nsec = (left % frq) * 1000000000 / frq;
+    }
+    tf->x[0] = -1;
+}
+
+void sys_clock_gettime(trapframe_t *tf) {
+    int clockid = tf->x[0];
+    struct timespec *tp = (struct timespec *)tf->x[1];
+    if (tp == NULL || (clockid != CLOCK_REALTIME && clockid != CLOCK_MONOTONIC)) {
+        tf->x[0] = -1; // Invalid argument
+        return;
+    }
+    unsigned long frq = read_cntfrq();
+    unsigned long now = read_cntpct(); // counts from boot
+    tp->tv_sec = now / frq;
+    tp->tv_nsec = (now % frq) * 1000000000 / frq;
+    tf->x[0] = 0;
+}
+
+// returns the clock ticks since boot; buf may be NULL
+void sys_times(trapframe_t *tf) {
+    struct tms *buf = (struct tms *)tf->x[0];
+    if (buf != NULL) {
+        unsigned long utime, stime;
+        thread_cputime(current_thread, &utime, &stime);
+        buf->tms_utime = ticks_to_clock_t(utime);
+        buf->tms_stime = ticks_to_clock_t(stime);
+        buf->tms_cutime = ticks_to_clock_t(current_thread->cutime_ticks);
+        buf->tms_cstime = ticks_to_clock_t(current_thread->cstime_ticks);
+    }
+    tf->x[0] = ticks_to_clock_t(read_cntpct());
+}
+
+void sys_waitpid(trapframe_t *tf) {
+    long pid = tf->x[0];          // -1: any child
+    int *status = (int *)tf->x[1]; // exit code of the child, may be NULL
+    int options = tf->x[2];
+    tf->x[0] = thread_waitpid(pid, status, options);
+}
+
+void sys_sched_setscheduler(trapframe_t *tf) {
+    int pid = tf->x[0];
+    int policy = tf->x[1];      // SCHED_NORMAL, SCHED_FIFO or SCHED_RR
+    int rt_priority = tf->x[2]; // 0 for SCHED_NORMAL
+    thread_t *target_thread = NULL;
+
+    if (pid == 0 || pid == current_thread->id) {
+        target_thread = current_thread;
     } else {
-        uart_send_string("Thread not found or cannot kill\r\n");
+        target_thread = find_thread_by_id(pid);
     }
-    enable_interrupt(daif);
+    if (target_thread == NULL) {
+        uart_send_string("[ERROR | SCHED_SETSCHEDULER] Thread not found\r\n");
+        tf->x[0] = -1;
+        return;
+    }
+    tf->x[0] = thread_setscheduler(target_thread, policy, rt_priority);
 }
 
-void sys_sigreturn(trapframe_t *tf) {
-    uart_send_string("[SYSCALL] sigreturn\r\n");
+void sys_futex(trapframe_t *tf) {
+    unsigned int *uaddr = (unsigned int *)tf->x[0];
+    int op = tf->x[1];
+    unsigned int val = tf->x[2];                               // WAIT: expected value, WAKE: max waiters
+    const struct timespec *timeout = (const struct timespec *)tf->x[3]; // WAIT only, NULL: forever
+
+    switch (op) {
+        case FUTEX_WAIT: {
+            unsigned long ticks = 0;
+            if (timeout != NULL) {
+                if (timeout->tv_sec < 0 || timeout->tv_nsec < 0 || timeout->tv_nsec >= 1000000000) {
+                    tf->x[0] = -1; // Invalid argument
+                    return;
+                }
+                unsigned long frq = read_cntfrq();
+                ticks = timeout->tv_sec * frq + timeout->tv_nsec * frq / 1000000000;
+                if (ticks == 0) {
+                    ticks = 1; // a zero timeout still must not sleep forever
+                }
+            }
+            tf->x[0] = futex_wait(uaddr, val, ticks);
+            break;
+        }
+        case FUTEX_WAKE:
+            tf->x[0] = futex_wake(uaddr, val);
+            break;
+        default:
+            uart_send_string("[ERROR | FUTEX] Unknown operation\r\n");
+            tf->x[0] = -1;
+            break;
+    }
+}
+
+// pid 0: the caller; mask is an unsigned long bitmap of cores, cpusetsize its size in bytes
+void sys_sched_setaffinity(trapframe_t *tf) {
+    int pid = tf->x[0];
+    size_t cpusetsize = tf->x[1];
+    const unsigned long *mask = (const unsigned long *)tf->x[2];
+    thread_t *target_thread = pid == 0 ? current_thread : find_thread_by_id(pid);
+    if (target_thread == NULL) {
+        uart_send_string("[ERROR | SETAFFINITY] Thread not found\r\n");
+        tf->x[0] = -1;
+        return;
+    }
+    if (mask == NULL || cpusetsize < sizeof(unsigned long)) {
+        tf->x[0] = -1; // Invalid argument
+        return;
+    }
+    tf->x[0] = thread_set_affinity(target_thread, *mask);
+}
 
-    // Restore the context from the signal handler
+// returns the size of the mask written
+void sys_sched_getaffinity(trapframe_t *tf) {
+    int pid = tf->x[0];
+    size_t cpusetsize = tf->x[1];
+    unsigned long *mask = (unsigned long *)tf->x[2];
+    thread_t *target_thread = pid == 0 ? current_thread : find_thread_by_id(pid);
+    if (target_thread == NULL) {
+        uart_send_string("[ERROR | GETAFFINITY] Thread not found\r\n");
+        tf->x[0] = -1;
+        return;
+    }
+    if (mask == NULL || cpusetsize < sizeof(unsigned long)) {
+        tf->x[0] = -1; // Invalid argument
+        return;
+    }
+    *mask = target_thread->cpus_allowed;
+    tf->x[0] = sizeof(unsigned long);
+}
 
-    free(current_thread->signal_stack_base); // Free the old user stack
-    free(current_thread->signal_kernel_stack_base); // Free the old kernel stack
-    current_thread->signal_stack_base = NULL;
-    current_thread->signal_kernel_stack_base = NULL;
+// --- batched i/o rings ---
+void sys_ring_setup(trapframe_t *tf) {
+    unsigned int entries = tf->x[0];  // ring size, a power of two up to URING_ENTRIES
+    unsigned int flags = tf->x[1];    // URING_SETUP_SQPOLL
+    unsigned long idle_us = tf->x[2]; // SQPOLL idle time, 0 for the default
+    tf->x[0] = uring_setup(entries, flags, idle_us);
+}
 
-    asm volatile (
-        "ldp x19, x20, [%0, 16 * 0]\n"
-        "ldp x21, x22, [%0, 16 * 1]\n"
-        "ldp x23, x24, [%0, 16 * 2]\n"
-        "ldp x25, x26, [%0, 16 * 3]\n"
-        "ldp x27, x28, [%0, 16 * 4]\n"
-        "ldp fp, lr, [%0, 16 * 5]\n"
-        "ldr x9, [%0, 16 * 6]\n"
-        "mov sp, x9\n"
-        "msr tpidr_el1, %1\n"
-        "ret\n"
-        : 
-        : "r"(current_thread->signal_context), "r" (current_thread->context)  // Input operand
-    );
+void sys_ring_enter(trapframe_t *tf) {
+    unsigned int to_submit = tf->x[0];
+    unsigned int min_complete = tf->x[1]; // with URING_ENTER_GETEVENTS
+    unsigned int flags = tf->x[2];
+    tf->x[0] = uring_enter(to_submit, min_complete, flags);
 }
 
 // --- vfs syscalls ---
@@ -284,32 +494,34 @@ void sys_open(trapframe_t *tf) {
     // uart_send_string("[SYSCALL 11] open\r\n");
     char *pathname = (char *)tf->x[0];
     int flags = tf->x[1];
-    for (int i = 0; i < MAX_FD; ++i) {
-        if (current_thread->files_table[i] == NULL                                    // empty slot
-                && vfs_open(pathname, flags, &current_thread->files_table[i]) == 0) { // successfully opened file
-            tf->x[0] = i; // Return the file descriptor
-            return;
-        }
+    struct file *file = NULL;
+    if (vfs_open(pathname, flags, &file) != 0) {
+        tf->x[0] = -1; // Return -1 if the file could not be opened
+        return;
+    }
+    int fd = fd_install(current_thread, file);
+    if (fd < 0) {
+        vfs_close(file); // no file descriptor is available
     }
-    tf->x[0] = -1; // Return -1 if no file descriptor is available
+    tf->x[0] = fd; // Return the file descriptor
 }
 
 void sys_close(trapframe_t *tf) {
     // uart_send_string("[SYSCALL 12] close\r\n");
     int fd = tf->x[0];
 
-    if (fd < 0 || fd >= MAX_FD || current_thread->files_table[fd] == NULL) {
+    struct file *file = fd_remove(current_thread, fd); // Clear the file descriptor
+    if (file == NULL) {
         uart_send_string("[ERROR | CLOSE] Invalid file descriptor\r\n");
         tf->x[0] = -1; // Return -1 if the file descriptor is invalid
         return;
     }
 
-    if(vfs_close(current_thread->files_table[fd]) != 0) {
+    if(vfs_close(file) != 0) {
         uart_send_string("[ERROR | CLOSE] Failed to close file\r\n");
         tf->x[0] = -1; // Return -1 if the file close operation failed
         return;
     }
-    current_thread->files_table[fd] = NULL; // Clear the file descriptor
     tf->x[0] = 0; // Return 0 on success
 }
 
@@ -318,13 +530,15 @@ void sys_write(trapframe_t *tf) {
     int fd = tf->x[0];
     char *buf = (char *)tf->x[1];
     size_t len = tf->x[2];
-    if (fd < 0 || fd >= MAX_FD || current_thread->files_table[fd] == NULL) {
+    struct file *file = fd_get(current_thread, fd); // a close() meanwhile can't free it
+    if (file == NULL) {
         uart_send_string("[ERROR | WRITE] Invalid file descriptor\r\n");
         tf->x[0] = -1; // Return -1 if the file descriptor is invalid
         return;
     }
 
-    int bytes_written = vfs_write(current_thread->files_table[fd], buf, len);
+    int bytes_written = vfs_write(file, buf, len);
+    vfs_close(file); // drop our reference
     if (bytes_written < 0) {
         uart_send_string("[ERROR | WRITE] Failed to write to file\r\n");
         tf->x[0] = -1; // Return -1 if the write operation failed
@@ -338,13 +552,15 @@ void sys_read(trapframe_t *tf) {
     int fd = tf->x[0];
     char *buf = (char *)tf->x[1];
     size_t len = tf->x[2];
-    if (fd < 0 || fd >= MAX_FD || current_thread->files_table[fd] == NULL) {
+    struct file *file = fd_get(current_thread, fd); // a close() meanwhile can't free it
+    if (file == NULL) {
         uart_send_string("[ERROR | READ] Invalid file descriptor\r\n");
         tf->x[0] = -1; // Return -1 if the file descriptor is invalid
         return;
     }
 
-    int bytes_read = vfs_read(current_thread->files_table[fd], buf, len);
+    int bytes_read = vfs_read(file, buf, len);
+    vfs_close(file); // drop our reference
     if (bytes_read < 0) {
         uart_send_string("[ERROR | READ] Failed to read from file\r\n");
         tf->x[0] = -1; // Return -1 if the read operation failed
@@ -392,13 +608,15 @@ void sys_lseek64(trapframe_t *tf) {
     long offset = tf->x[1];
     int whence = tf->x[2];
 
-    if (fd < 0 || fd >= MAX_FD || current_thread->files_table[fd] == NULL) {
+    struct file *file = fd_get(current_thread, fd); // a close() meanwhile can't free it
+    if (file == NULL) {
         uart_send_string("[ERROR | LSEEK64] Invalid file descriptor\r\n");
         tf->x[0] = -1; // Return -1 if the file descriptor is invalid
         return;
     }
 
-    long new_offset = current_thread->files_table[fd]->f_ops->lseek64(current_thread->files_table[fd], offset, whence);
+    long new_offset = vfs_lseek64(file, offset, whence);
+    vfs_close(file); // drop our reference
     if (new_offset < 0) {
         uart_send_string("[ERROR | LSEEK64] Failed to seek in file\r\n");
         tf->x[0] = -1; // Return -1 if the lseek operation failed
@@ -407,6 +625,139 @@ void sys_lseek64(trapframe_t *tf) {
     tf->x[0] = new_offset; // Return the new offset
 }
 
+void sys_readv(trapframe_t *tf) {
+    int fd = tf->x[0];
+    const struct iovec *iov = (const struct iovec *)tf->x[1];
+    int iovcnt = tf->x[2];
+    struct file *file = fd_get(current_thread, fd); // a close() meanwhile can't free it
+    if (file == NULL) {
+        uart_send_string("[ERROR | READV] Invalid file descriptor\r\n");
+        tf->x[0] = -1; // Return -1 if the file descriptor is invalid
+        return;
+    }
+    if (iovcnt < 0 || iovcnt > UIO_MAXIOV) {
+        vfs_close(file);
+        tf->x[0] = -1; // Invalid argument
+        return;
+    }
+    tf->x[0] = vfs_readv(file, iov, iovcnt); // Return the number of bytes read
+    vfs_close(file); // drop our reference
+}
+
+void sys_writev(trapframe_t *tf) {
+    int fd = tf->x[0];
+    const struct iovec *iov = (const struct iovec *)tf->x[1];
+    int iovcnt = tf->x[2];
+    struct file *file = fd_get(current_thread, fd); // a close() meanwhile can't free it
+    if (file == NULL) {
+        uart_send_string("[ERROR | WRITEV] Invalid file descriptor\r\n");
+        tf->x[0] = -1; // Return -1 if the file descriptor is invalid
+        return;
+    }
+    if (iovcnt < 0 || iovcnt > UIO_MAXIOV) {
+        vfs_close(file);
+        tf->x[0] = -1; // Invalid argument
+        return;
+    }
+    tf->x[0] = vfs_writev(file, iov, iovcnt); // Return the number of bytes written
+    vfs_close(file); // drop our reference
+}
+
+void sys_pread64(trapframe_t *tf) {
+    int fd = tf->x[0];
+    char *buf = (char *)tf->x[1];
+    size_t len = tf->x[2];
+    long pos = tf->x[3];
+    struct file *file = fd_get(current_thread, fd); // a close() meanwhile can't free it
+    if (file == NULL) {
+        uart_send_string("[ERROR | PREAD64] Invalid file descriptor\r\n");
+        tf->x[0] = -1; // Return -1 if the file descriptor is invalid
+        return;
+    }
+    if (pos < 0) {
+        vfs_close(file);
+        tf->x[0] = -1; // Invalid argument
+        return;
+    }
+    tf->x[0] = vfs_pread(file, buf, len, pos); // f_pos is left alone
+    vfs_close(file); // drop our reference
+}
+
+void sys_pwrite64(trapframe_t *tf) {
+    int fd = tf->x[0];
+    const char *buf = (const char *)tf->x[1];
+    size_t len = tf->x[2];
+    long pos = tf->x[3];
+    struct file *file = fd_get(current_thread, fd); // a close() meanwhile can't free it
+    if (file == NULL) {
+        uart_send_string("[ERROR | PWRITE64] Invalid file descriptor\r\n");
+        tf->x[0] = -1; // Return -1 if the file descriptor is invalid
+        return;
+    }
+    if (pos < 0) {
+        vfs_close(file);
+        tf->x[0] = -1; // Invalid argument
+        return;
+    }
+    tf->x[0] = vfs_pwrite(file, buf, len, pos); // f_pos is left alone
+    vfs_close(file); // drop our reference
+}
+
+void sys_shm_open(trapframe_t *tf) {
+    const char *name = (const char *)tf->x[0];
+    size_t size = tf->x[1]; // 0: open an existing segment
+    int flags = tf->x[2];
+    tf->x[0] = shm_open(name, size, flags);
+}
+
+void sys_shm_attach(trapframe_t *tf) {
+    tf->x[0] = shm_attach(tf->x[0]);
+}
+
+void sys_shm_detach(trapframe_t *tf) {
+    tf->x[0] = shm_detach(tf->x[0]);
+}
+
+void sys_shm_unlink(trapframe_t *tf) {
+    tf->x[0] = shm_unlink((const char *)tf->x[0]);
+}
+
+// fds[0] gets the read end, fds[1] the write end
+void sys_pipe(trapframe_t *tf) {
+    int *fds = (int *)tf->x[0];
+    if (fds == NULL) {
+        tf->x[0] = -1; // Invalid argument
+        return;
+    }
+    struct file *read_end, *write_end;
+    if (pipe_create(&read_end, &write_end) != 0) {
+        uart_send_string("[ERROR | PIPE] Out of memory\r\n");
+        tf->x[0] = -1;
+        return;
+    }
+    int read_fd = fd_install(current_thread, read_end);
+    int write_fd = read_fd < 0 ? -1 : fd_install(current_thread, write_end);
+    if (write_fd < 0) { // two free file descriptors are needed
+        if (read_fd >= 0) {
+            fd_remove(current_thread, read_fd);
+        }
+        vfs_close(read_end);
+        vfs_close(write_end);
+        tf->x[0] = -1;
+        return;
+    }
+    fds[0] = read_fd;
+    fds[1] = write_fd;
+    tf->x[0] = 0;
+}
+
+void sys_poll(trapframe_t *tf) {
+    struct pollfd *fds = (struct pollfd *)tf->x[0];
+    unsigned int nfds = tf->x[1];
+    long timeout_ms = (int)tf->x[2]; // -1: no timeout
+    tf->x[0] = do_poll(fds, nfds, timeout_ms);
+}
+
 void sys_ioctl(trapframe_t *tf) {
     // // uart_send_string("[SYSCALL 19] ioctl\r\n");
     // int fd = tf->x[0];
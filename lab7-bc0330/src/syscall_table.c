@@ -0,0 +1,129 @@
+#include <stddef.h>
+#include "allocator.h"
+#include "mini_uart.h"
+#include "schedstat.h"
+#include "spinlock.h"
+#include "syscall.h"
+#include "utils.h"
+
+const syscall_entry_t syscall_table[NR_SYSCALLS] = {
+    [0]  = { sys_get_pid,            "getpid",             0, 0 },
+    [1]  = { sys_uart_read,          "uart_read",          2, SYSCALL_MAY_BLOCK },
+    [2]  = { sys_uart_write,         "uart_write",         2, 0 },
+    [3]  = { sys_exec,               "exec",               2, SYSCALL_MAY_BLOCK },
+    [4]  = { sys_fork,               "fork",               0, SYSCALL_MAY_BLOCK },
+    [5]  = { sys_exit,               "exit",               1, SYSCALL_MAY_BLOCK },
+    [6]  = { sys_mbox_call,          "mbox_call",          2, 0 },
+    [7]  = { sys_kill,               "kill",               2, SYSCALL_MAY_BLOCK },
+    [8]  = { sys_signal,             "signal",             2, 0 },
+    [9]  = { sys_sigkill,            "sigkill",            2, 0 },
+    [10] = { sys_sigreturn,          "sigreturn",          0, 0 },
+    [11] = { sys_open,               "open",               2, 0 },
+    [12] = { sys_close,              "close",              1, 0 },
+    [13] = { sys_write,              "write",              3, SYSCALL_MAY_BLOCK },
+    [14] = { sys_read,               "read",               3, SYSCALL_MAY_BLOCK },
+    [15] = { sys_mkdir,              "mkdir",              2, 0 },
+    [16] = { sys_mount,              "mount",              5, 0 },
+    [17] = { sys_chdir,              "chdir",              1, 0 },
+    [18] = { sys_lseek64,            "lseek64",            3, 0 },
+    [19] = { sys_ioctl,              "ioctl",              3, 0 },
+    [20] = { sys_setpriority,        "setpriority",        2, 0 },
+    [21] = { sys_nice,               "nice",               1, 0 },
+    [22] = { sys_nanosleep,          "nanosleep",          2, SYSCALL_MAY_BLOCK },
+    [23] = { sys_waitpid,            "waitpid",            3, SYSCALL_MAY_BLOCK },
+    [24] = { sys_sched_setscheduler, "sched_setscheduler", 3, SYSCALL_MAY_BLOCK },
+    [25] = { sys_futex,              "futex",              4, SYSCALL_MAY_BLOCK },
+    [26] = { sys_sched_setaffinity,  "sched_setaffinity",  3, 0 },
+    [27] = { sys_sched_getaffinity,  "sched_getaffinity",  3, 0 },
+    [28] = { sys_ring_setup,         "ring_setup",         3, 0 },
+    [29] = { sys_ring_enter,         "ring_enter",         3, SYSCALL_MAY_BLOCK },
+    [30] = { sys_sigprocmask,        "sigprocmask",        3, 0 },
+    [31] = { sys_readv,              "readv",              3, SYSCALL_MAY_BLOCK },
+    [32] = { sys_writev,             "writev",             3, SYSCALL_MAY_BLOCK },
+    [33] = { sys_pread64,            "pread64",            4, SYSCALL_MAY_BLOCK },
+    [34] = { sys_pwrite64,           "pwrite64",           4, SYSCALL_MAY_BLOCK },
+    [35] = { sys_clock_gettime,      "clock_gettime",      2, 0 },
+    [36] = { sys_times,              "times",              1, 0 },
+    [37] = { sys_pipe,               "pipe",               1, 0 },
+    [38] = { sys_shm_open,           "shm_open",           3, 0 },
+    [39] = { sys_shm_attach,         "shm_attach",         1, 0 },
+    [40] = { sys_shm_detach,         "shm_detach",         1, 0 },
+    [41] = { sys_shm_unlink,         "shm_unlink",         1, 0 },
+    [42] = { sys_poll,               "poll",               3, SYSCALL_MAY_BLOCK },
+};
+
+/*
+    calls is bumped on entry so exit, which never returns, is still
+    counted; latency only has samples for calls that came back.
+*/
+static unsigned long syscall_calls[NR_SYSCALLS];
+static sched_hist_t syscall_latency[NR_SYSCALLS];
+static DEFINE_SPINLOCK(calls_lock);
+
+void syscall_enter(unsigned long nr) {
+    unsigned long flags;
+    spin_lock_irqsave(&calls_lock, flags);
+    syscall_calls[nr]++;
+    spin_unlock_irqrestore(&calls_lock, flags);
+}
+
+// called with interrupts masked
+void syscall_account(unsigned long nr, unsigned long ticks) {
+    schedstat_record(&syscall_latency[nr], ticks);
+}
+
+static void syscallstat_reset(void) {
+    unsigned long flags;
+    spin_lock_irqsave(&calls_lock, flags);
+    memset((char *)syscall_calls, 0, sizeof(syscall_calls));
+    spin_unlock_irqrestore(&calls_lock, flags);
+    for (int i = 0; i < NR_SYSCALLS; ++i) {
+        schedstat_clear_hist(&syscall_latency[i]);
+    }
+}
+
+static size_t syscallstat_render(char *buf, size_t size) {
+    stat_buf_t b = { buf, size, 0 };
+    stat_puts(&b, "nr name args flags calls\n");
+    for (int i = 0; i < NR_SYSCALLS; ++i) {
+        const syscall_entry_t *entry = &syscall_table[i];
+        if (entry->fn == NULL || syscall_calls[i] == 0) {
+            continue;
+        }
+        stat_putnum(&b, i);
+        stat_puts(&b, " ");
+        stat_puts(&b, entry->name);
+        stat_puts(&b, " ");
+        stat_putnum(&b, entry->nargs);
+        stat_puts(&b, " ");
+        stat_puts(&b, (entry->flags & SYSCALL_MAY_BLOCK) ? "B" : "-");
+        stat_puts(&b, " ");
+        stat_putnum(&b, syscall_calls[i]);
+        stat_puts(&b, "\n");
+        stat_render_hist(&b, "  latency", &syscall_latency[i]);
+    }
+    return b.len;
+}
+
+void print_syscall_stats(void) {
+    char *buf = allocate(SYSCALLSTAT_BUF_SIZE + 1);
+    if (buf == NULL) {
+        uart_send_string("[ERROR | SYSCALLSTAT] Out of memory\r\n");
+        return;
+    }
+    buf[syscallstat_render(buf, SYSCALLSTAT_BUF_SIZE)] = '\0';
+    uart_send_string(buf);
+    free(buf);
+}
+
+static const stat_dev_t syscallstat_dev = {
+    .render = syscallstat_render,
+    .reset = syscallstat_reset,
+    .buf_size = SYSCALLSTAT_BUF_SIZE,
+};
+
+void syscallstat_init(void) {
+    if (stat_dev_register("syscallstat", &syscallstat_dev) != 0) {
+        uart_send_string("[ERROR | SYSCALLSTAT] Failed to create /dev/syscallstat\r\n");
+    }
+}
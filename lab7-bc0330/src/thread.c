@@ -1,35 +1,227 @@
 #include "allocator.h"
 #include "exception_handler.h"
+#include "fpsimd.h"
 #include "mini_uart.h"
 #include "mmu.h"
 #include <stddef.h>
+#include "pid.h"
+#include "schedstat.h"
+#include "shm.h"
+#include "signal.h"
+#include "spinlock.h"
 #include "thread.h"
+#include "timer.h"
+#include "uring.h"
 #include "utils.h"
 #include "vfs.h"
+#include "workqueue.h"
 
-thread_queue_t run_queue[3]; // Global run queue
+prio_array_t run_queue;      // Global run queue
+cfs_rq_t cfs_run_queue;      // Global fair run queue
+prio_array_t rt_run_queue;   // SCHED_FIFO/SCHED_RR threads
+#ifdef SCHED_DEFAULT_CFS
+const struct sched_class *sched_class = &fair_sched_class;
+#else
+const struct sched_class *sched_class = &rr_sched_class;
+#endif
 thread_queue_t wait_queue;  // Global wait queue
 thread_queue_t zombies_queue; // Global zombies queue
+static DEFINE_SPINLOCK(rq_lock);     // protects both run queues, thread states and current_thread
+static DEFINE_SPINLOCK(zombie_lock); // protects zombies_queue
+DEFINE_SPINLOCK(tasklist_lock);      // protects parent/children/sibling links
 thread_t *current_thread;
-unsigned long counter = 0;
+thread_t *idle_threads[NR_CPUS]; // one per CPU, runs only when nothing else is runnable
+unsigned long cpu_online_mask = 0; // set by init_idle() on each core
+static struct file *console_files[3]; // stdin, stdout, stderr shared by every thread
+int need_resched = 0;        // set by wakeups that should preempt, cleared by schedule()
+unsigned long rt_max_wakeup_latency = 0;
+
+/*
+    RT throttling: within every rt_period_us, RT threads may use at most
+    rt_runtime_us of CPU time while normal threads are waiting, so a
+    runaway FIFO thread can't lock out the shell. Both can be changed
+    with "rt_runtime_us=" and "rt_period_us=" in the boot arguments;
+    runtime >= period disables the throttle.
+*/
+static unsigned long rt_runtime_us = 950000;
+static unsigned long rt_period_us = 1000000;
+static unsigned long rt_period_start = 0; // cntpct when the current period began
+static unsigned long rt_time = 0;         // RT run time in this period, in ticks
+static int rt_throttled = 0;
+static unsigned long switch_stamp[NR_CPUS]; // cntpct when switch_to() was entered
+
+static inline const struct sched_class *class_of(thread_t *t) {
+    return t->policy == SCHED_NORMAL ? sched_class : &rt_sched_class;
+}
+
+// reaped threads keep their stacks and are reused by the next thread_alloc()
+#define THREAD_CACHE_MAX 32
+static thread_t *thread_cache = NULL;
+static int thread_cache_count = 0;
+static DEFINE_SPINLOCK(thread_cache_lock);
+
+/*
+    Pick the scheduling class. The build default (SCHED=cfs in the Makefile)
+    can be overridden with "sched=rr" or "sched=cfs" in the boot arguments.
+*/
+static int bootarg_is(const char *arg, const char *opt) {
+    while (*opt != '\0') {
+        if (*arg++ != *opt++) {
+            return 0;
+        }
+    }
+    return *arg == '\0' || *arg == ' ';
+}
+
+// value of a "key=value" argument, NULL if arg is some other option
+static const char *bootarg_value(const char *arg, const char *key) {
+    while (*key != '\0') {
+        if (*arg++ != *key++) {
+            return NULL;
+        }
+    }
+    return arg;
+}
+
+void sched_init(const char *bootargs) {
+    const char *p = bootargs;
+    const char *val;
+    while (p != NULL && *p != '\0') {
+        if (bootarg_is(p, "sched=cfs")) {
+            sched_class = &fair_sched_class;
+        } else if (bootarg_is(p, "sched=rr")) {
+            sched_class = &rr_sched_class;
+        } else if ((val = bootarg_value(p, "rt_runtime_us=")) != NULL) {
+            rt_runtime_us = atoi(val);
+        } else if ((val = bootarg_value(p, "rt_period_us=")) != NULL && atoi(val) > 0) {
+            rt_period_us = atoi(val);
+        }
+        while (*p != '\0' && *p != ' ') {
+            p++; // skip to the next argument
+        }
+        while (*p == ' ') {
+            p++;
+        }
+    }
+    uart_send_string("Scheduler: ");
+    uart_send_string((char *)sched_class->name);
+    uart_send_string(", RT runtime ");
+    uart_send_num(rt_runtime_us, "dec");
+    uart_send_string("/");
+    uart_send_num(rt_period_us, "dec");
+    uart_send_string(" us\r\n");
+}
 
 void init_thread(void) {
-    current_thread = thread_create(idle, LOW_PRIORITY, NULL, 0);
+    init_pid();
+    run_queue.bitmap = 0;
+    run_queue.nr_running = 0;
+    for (int i = 0; i < NR_PRIO; i++) {
+        run_queue.queue[i].head = NULL;
+        run_queue.queue[i].tail = NULL;
+    }
+    cfs_run_queue.tasks.node = NULL;
+    cfs_run_queue.leftmost = NULL;
+    cfs_run_queue.min_vruntime = 0;
+    cfs_run_queue.load = 0;
+    cfs_run_queue.nr_running = 0;
+    rt_run_queue.bitmap = 0;
+    rt_run_queue.nr_running = 0;
+    for (int i = 0; i < NR_PRIO; i++) {
+        rt_run_queue.queue[i].head = NULL;
+        rt_run_queue.queue[i].tail = NULL;
+    }
+    rt_period_start = read_cntpct();
+    wait_queue.head = NULL;
+    wait_queue.tail = NULL;
+    zombies_queue.head = NULL;
+    zombies_queue.tail = NULL;
+
+    // opened once, every thread gets a reference
+    vfs_open("/dev/uart/stdin", O_RDONLY, &console_files[0]);
+    vfs_open("/dev/uart/stdout", O_WRONLY, &console_files[1]);
+    vfs_open("/dev/uart/stderr", O_WRONLY, &console_files[2]);
+
+    init_idle();
+}
+
+/*
+    Turn the calling CPU's boot context into its idle thread. The idle
+    thread lives as long as the CPU: it is never queued and schedule()
+    falls back to it when nothing else is runnable.
+*/
+void init_idle(void) {
+    thread_t *t = thread_create(idle, LOW_PRIORITY, NULL, 0);
+    thread_remove_from_queue(t);
+    t->state = THREAD_RUNNING;
+    t->exec_start = read_cntpct();
+    t->slice_start = t->exec_start;
+    t->last_arrival = t->exec_start;
+    t->cpu = smp_processor_id();
+    t->cpus_allowed = 1UL << t->cpu; // never migrates
+    idle_thread = t;
+    cpu_online_mask |= 1UL << t->cpu;
+    current_thread = t;
     asm volatile (
         "msr tpidr_el1, %0\n"
         : /* no output */
         : "r" (current_thread->context)
     );
-    for (int i = 0; i < 3; i++) {
-        run_queue[i].head = (NULL);
-        run_queue[i].tail = NULL;
+}
+
+/*
+    A thread_t with its user and kernel stacks, from the cache when
+    possible. The stacks are not cleared.
+*/
+thread_t *thread_alloc(void) {
+    unsigned long flags;
+    spin_lock_irqsave(&thread_cache_lock, flags);
+    thread_t *thread = thread_cache;
+    if (thread != NULL) {
+        thread_cache = thread->next;
+        thread_cache_count--;
+    }
+    spin_unlock_irqrestore(&thread_cache_lock, flags);
+    if (thread != NULL) {
+        return thread;
+    }
+
+    thread = (thread_t *)allocate(sizeof(thread_t)); // Allocate memory for the thread structure
+    if (!thread) {
+        uart_send_string("Memory allocation failed for thread\n");
+        return NULL; // Memory allocation failed
+    }
+    thread->usr_stack_base = allocate(4 * thread_stack_size); // Allocate stack for the thread
+    thread->kernel_stack_base = allocate(thread_stack_size); // Allocate kernel stack for the thread
+    if (!thread->usr_stack_base || !thread->kernel_stack_base) {
+        uart_send_string("Memory allocation failed for thread stack\n");
+        if (thread->usr_stack_base) {
+            free(thread->usr_stack_base);
+        }
+        if (thread->kernel_stack_base) {
+            free(thread->kernel_stack_base);
+        }
+        free(thread);
+        return NULL; // Memory allocation failed
+    }
+    return thread;
+}
+
+void thread_free(thread_t *thread) {
+    unsigned long flags;
+    spin_lock_irqsave(&thread_cache_lock, flags);
+    if (thread_cache_count < THREAD_CACHE_MAX) {
+        thread->next = thread_cache;
+        thread_cache = thread;
+        thread_cache_count++;
+        thread = NULL;
+    }
+    spin_unlock_irqrestore(&thread_cache_lock, flags);
+    if (thread != NULL) { // cache full
+        free(thread->usr_stack_base);
+        free(thread->kernel_stack_base);
+        free(thread);
     }
-    run_queue[LOW_PRIORITY].head = current_thread;
-    run_queue[LOW_PRIORITY].tail = current_thread;
-    wait_queue.head = NULL;
-    wait_queue.tail = NULL;
-    zombies_queue.head = NULL;
-    zombies_queue.tail = NULL;
 }
 
 void __asm_impl() {
@@ -72,34 +264,50 @@ void __asm_impl() {
 }
 
 thread_t *thread_create(void (*function)(void), int priority, void (*user_prog)(void), size_t prog_size) {
-    thread_t *thread = (thread_t *)allocate(sizeof(thread_t)); // Allocate memory for the thread structure
+    thread_t *thread = thread_alloc(); // thread_t and both stacks
     if (!thread) {
-        uart_send_string("Memory allocation failed for thread\n");
         return NULL; // Memory allocation failed
     }
 
-    thread->id = counter++; // Assign a unique ID to the thread
+    thread->id = alloc_pid(); // Assign a unique ID to the thread
+    if (thread->id == PID_INVALID) {
+        thread_free(thread);
+        return NULL;
+    }
     thread->priority = priority;
+    thread->policy = SCHED_NORMAL; // sched_setscheduler() moves it to the RT class
+    thread->rt_priority = 0;
+    thread->wakeup_stamp = 0;
+    thread->cpus_allowed = CPU_MASK_ALL;
+    thread->cpu = smp_processor_id();
+    schedstat_clear(thread);
     thread->function = function;
     thread->user_prog = user_prog;
     thread->prog_size = prog_size;
-    thread->state = THREAD_WAITING; // Set the initial state to ready
-    thread->signal = 0; // Initialize the signal to 0
-    thread->usr_stack_base = allocate(4 * thread_stack_size); // Allocate stack for the thread
-    thread->kernel_stack_base = allocate(thread_stack_size); // Allocate kernel stack for the thread
-    thread->signal_stack_base = NULL; // Initialize the signal stack base to NULL
-    thread->signal_kernel_stack_base = NULL; // Initialize the signal kernel stack base to NULL
-
-    if (!thread->usr_stack_base || !thread->kernel_stack_base) {
-        uart_send_string("Memory allocation failed for thread stack\n");
-        free(thread);
-        return NULL; // Memory allocation failed
+    thread->state = THREAD_READY; // Set the initial state to ready
+    thread->exit_code = 0;
+    thread->killed = 0;
+    thread->preempt_count = 0;
+    thread->parent = NULL; // kernel threads are nobody's children
+    thread->children = NULL;
+    thread->sibling = NULL;
+    init_waitqueue_head(&thread->wait_child);
+    thread->vruntime = cfs_run_queue.min_vruntime; // start level with the queue
+    thread->exec_start = 0;
+    thread->slice_start = 0;
+    signal_init(thread);
+    thread->fpsimd = NULL;
+    thread->ring = NULL;
+    for (int i = 0; i < SHM_ATTACH_MAX; ++i) {
+        thread->shm[i] = NULL;
     }
+
     // setup_thread_peripherals(thread->pgd); // Set up the thread's peripherals
     thread->pgd = allocate(PAGE_SIZE); // Allocate a page for the thread's page directory
     memset((char *)thread->pgd, 0, PAGE_SIZE); // Initialize the page directory to zero
-    memset((char *)thread->usr_stack_base, 0, 4 * thread_stack_size); // Initialize the stack to zero
-    memset((char *)thread->kernel_stack_base, 0, thread_stack_size); // Initialize the kernel stack to zero
+    if (user_prog != NULL) {
+        memset((char *)thread->usr_stack_base, 0, 4 * thread_stack_size); // don't leak a reaped thread's data to EL0
+    }
 
     for (int i = 0; i < 4; ++i) {
         mappages(thread->pgd, 0xFFFFFFFFB000 + i * PAGE_SIZE, vtop((unsigned long)thread->usr_stack_base + i * PAGE_SIZE), PD_USR_ACCESS); // Map the user stack pages
@@ -109,7 +317,6 @@ thread_t *thread_create(void (*function)(void), int priority, void (*user_prog)(
     thread->kernel_stack = thread->kernel_stack_base + thread_stack_size; // Set the kernel stack pointer to the top of the stack
 
     memset((char *)thread->context, 0, sizeof(thread->context)); // Initialize the stack to zero
-    memset((char *)thread->signal_context, 0, sizeof(thread->signal_context)); // Initialize the signal context to zero
 
     if (user_prog != NULL) {
         for (size_t i = 0; i < prog_size; i += PAGE_SIZE) {
@@ -125,22 +332,18 @@ thread_t *thread_create(void (*function)(void), int priority, void (*user_prog)(
     for (int i = 0; i < MAX_FD; ++i) {
         thread->files_table[i] = NULL; // Initialize the file descriptors table to NULL
     }
-    struct file *stdin;
-    struct file *stdout;
-    struct file *stderr;
-    vfs_open("/dev/uart/stdin", O_RDONLY, &stdin);
-    vfs_open("/dev/uart/stdout", O_WRONLY, &stdout);
-    vfs_open("/dev/uart/stderr", O_WRONLY, &stderr);
-    thread->files_table[0] = stdin;  // Set stdin to file descriptor 0
-    thread->files_table[1] = stdout; // Set stdout to file descriptor 1
-    thread->files_table[2] = stderr; // Set stderr to file descriptor 2
+    spin_lock_init(&thread->files_lock, "files");
+    thread->files_table[0] = vfs_dup(console_files[0]); // Set stdin to file descriptor 0
+    thread->files_table[1] = vfs_dup(console_files[1]); // Set stdout to file descriptor 1
+    thread->files_table[2] = vfs_dup(console_files[2]); // Set stderr to file descriptor 2
 
     thread->prev = NULL;
     thread->next = NULL;
 
     thread->context[12] = (unsigned long)thread->kernel_stack; // Set the stack pointer in the context
-    thread->context[11] = (unsigned long)function; // Set the function to execute in the context
+    thread->context[11] = (unsigned long)thread_start; // runs function once the switch is finished
     thread->context[10] = (unsigned long)thread->kernel_stack_base; // Set the stack pointer in the context
+    attach_pid(thread); // visible to kill() from now on
     thread_enqueue(thread); // Add the thread to the run queue
     // thread->pgd = (void *)vtop((unsigned long)thread->pgd); // Convert the page directory to physical address
     return thread;
@@ -148,18 +351,27 @@ thread_t *thread_create(void (*function)(void), int priority, void (*user_prog)(
 
 void thread_start(void) {
     // Call the function associated with the thread
-    uart_send_string("Thread started\n");
+    // uart_send_string("Thread started\n");
+    schedule_tail();
     current_thread->function();
     thread_exit();
 }
 
-void thread_kill(thread_t *t, int status) {
-    t->state = THREAD_DEAD; // Set the thread state to dead
-    if (t != current_thread) {
-        thread_remove_from_queue(t); // Remove the thread from the run queue
-    }
-    t->exit_code = status; // Set the exit code
-    t->next = NULL; // Clear the next pointer
+/*
+    The reaper returns the memory of exited threads from the low priority
+    worker, so neither exit() nor the threads still running pay for
+    freeing stacks and page tables.
+*/
+static void reaper(struct work_struct *work) {
+    kill_zombies();
+}
+static DECLARE_WORK(reap_work, reaper);
+
+// hand an exited thread that nobody will wait for to the reaper
+static void zombie_push(thread_t *t) {
+    unsigned long flags;
+    spin_lock_irqsave(&zombie_lock, flags);
+    t->next = NULL;
     t->prev = NULL;
     if (zombies_queue.head == NULL) {
         zombies_queue.head = t;
@@ -168,56 +380,310 @@ void thread_kill(thread_t *t, int status) {
         zombies_queue.tail->next = t;
         zombies_queue.tail = t;
     }
+    spin_unlock_irqrestore(&zombie_lock, flags);
+    queue_work(system_lowpri_wq, &reap_work);
+}
+
+/*
+    Killing another thread only marks it: it may be sleeping with timers
+    and wait queue entries on its kernel stack, so it has to unwind and
+    exit by itself, which it does before its next return to EL0.
+*/
+void thread_kill(thread_t *t, int status) {
+    if (t == current_thread) {
+        do_exit(status);
+    }
+    unsigned long flags;
+    spin_lock_irqsave(&rq_lock, flags);
+    if (t->state == THREAD_DEAD) {
+        spin_unlock_irqrestore(&rq_lock, flags);
+        return; // already exiting
+    }
+    t->exit_code = status; // Set the exit code
+    t->killed = 1;
+    spin_unlock_irqrestore(&rq_lock, flags);
+    thread_wakeup(t); // cut a sleep short
+}
+
+void thread_check_killed(void) {
+    if (current_thread->killed) {
+        do_exit(current_thread->exit_code);
+    }
+}
+
+// last step before returning to EL0: honour a pending preemption, kill or signal
+void exit_to_user(trapframe_t *tf) {
+    if (need_resched) {
+        schedule();
+    }
+    thread_check_killed();
+    if (signal_pending(current_thread)) {
+        do_signal(tf); // rewrites tf to enter the handler
+    }
 }
 
 void thread_exit(void) {
-    unsigned long daif = disable_interrupt();
-    uart_send_num(current_thread->id, "hex");
-    uart_send_string(" Thread exiting\r\n");
-    vfs_close(current_thread->files_table[0]); // Close stdin
-    vfs_close(current_thread->files_table[1]); // Close stdout
-    vfs_close(current_thread->files_table[2]); // Close stderr
-    current_thread->state = THREAD_DEAD; // Set the thread state to dead
-    current_thread->next = NULL; // Clear the next pointer
-    current_thread->prev = NULL; // Clear the previous pointer
-    current_thread->exit_code = 0; // Set the exit code
-    if (zombies_queue.head == NULL) {
-        zombies_queue.head = current_thread;
-        zombies_queue.tail = current_thread;
+    do_exit(0);
+}
+
+void do_exit(int status) {
+    thread_t *self = current_thread;
+    // uart_send_num(self->id, "hex");
+    // uart_send_string(" Thread exiting\r\n");
+    uring_release(self); // stops its poller before the files go away
+    shm_release(self);
+    for (int i = 0; i < MAX_FD; ++i) {
+        if (self->files_table[i] != NULL) {
+            vfs_close(self->files_table[i]);
+            self->files_table[i] = NULL;
+        }
+    }
+
+    disable_interrupt(); // stays masked until we switch away
+    spin_lock(&tasklist_lock);
+    // orphan the children; the ones that already exited go to the reaper
+    thread_t *child = self->children;
+    while (child != NULL) {
+        thread_t *next = child->sibling;
+        child->parent = NULL;
+        child->sibling = NULL;
+        if (child->state == THREAD_DEAD) {
+            zombie_push(child);
+        }
+        child = next;
+    }
+    self->children = NULL;
+
+    spin_lock(&rq_lock);
+    self->exit_code = status; // Set the exit code
+    self->state = THREAD_DEAD; // schedule() won't requeue us
+    spin_unlock(&rq_lock);
+
+    if (self->parent != NULL) {
+        wake_up(&self->parent->wait_child); // the parent collects us in waitpid()
     } else {
-        zombies_queue.tail->next = current_thread;
-        zombies_queue.tail = current_thread;
+        zombie_push(self);
     }
-    enable_interrupt(daif);
+    spin_unlock(&tasklist_lock);
     schedule();
     while(1);
 }
 
+/*
+    Look for an exited child matching pid (-1: any child). Returns its
+    id after unlinking it and passing it to the reaper, 0 if matching
+    children exist but none has exited, -1 if there is no such child.
+*/
+static long reap_child(thread_t *self, long pid, int *status) {
+    unsigned long flags;
+    long ret = -1;
+    spin_lock_irqsave(&tasklist_lock, flags);
+    thread_t **link = &self->children;
+    while (*link != NULL) {
+        thread_t *child = *link;
+        if (pid == -1 || child->id == (pid_t)pid) {
+            if (child->state == THREAD_DEAD) {
+                *link = child->sibling; // unlink from our children
+                child->parent = NULL;
+                child->sibling = NULL;
+                if (status != NULL) {
+                    *status = child->exit_code;
+                }
+                unsigned long utime, stime;
+                thread_cputime(child, &utime, &stime);
+                self->cutime_ticks += utime + child->cutime_ticks;
+                self->cstime_ticks += stime + child->cstime_ticks;
+                ret = child->id;
+                zombie_push(child);
+                break;
+            }
+            ret = 0; // still running
+        }
+        link = &child->sibling;
+    }
+    spin_unlock_irqrestore(&tasklist_lock, flags);
+    return ret;
+}
+
+long thread_waitpid(long pid, int *status, int options) {
+    thread_t *self = current_thread;
+    long ret;
+    if (options & WNOHANG) {
+        return reap_child(self, pid, status);
+    }
+    wait_event(self->wait_child, (ret = reap_child(self, pid, status)) != 0 || self->killed);
+    return ret == 0 ? -1 : ret; // 0 here: interrupted by thread_kill()
+}
+
+
+/*
+    Placement. All cores share the run queues: a queued thread is placed
+    on an allowed online core and the core that picks it becomes its cpu.
+    With only the boot core online every mask thread_set_affinity()
+    accepts contains it, so pick_next_thread() never has to skip one;
+    per-core run queues are needed before secondary cores come up.
+*/
+static void set_task_cpu(thread_t *t, int cpu) {
+    if (t->cpu != cpu) {
+        t->nr_migrations++;
+        t->cpu = cpu;
+    }
+}
 
+// the core t last used if still allowed, otherwise the lowest allowed online core
+static int select_task_rq(thread_t *t) {
+    unsigned long allowed = t->cpus_allowed & cpu_online_mask;
+    if (allowed & (1UL << t->cpu)) {
+        return t->cpu;
+    }
+    return allowed != 0 ? __builtin_ctzl(allowed) : t->cpu;
+}
+
+static void rt_period_check(void);
+static void rt_update_curr(thread_t *curr);
+static void update_curr(thread_t *curr);
+static void update_min_vruntime(void);
+
+/*
+    RT threads run first unless throttled; a throttled RT class still runs
+    when no normal thread wants the CPU.
+*/
+static thread_t *pick_next_thread(void) {
+    rt_period_check();
+    if (rt_run_queue.nr_running > 0 && (!rt_throttled || sched_class->nr_running() == 0)) {
+        return rt_sched_class.pick_next();
+    }
+    return sched_class->pick_next();
+}
+
+/*
+    rq_lock is held across switch_to(), otherwise another CPU could pick
+    prev from the run queue before its registers are saved. Whoever runs
+    next drops it: the tail of this function for a thread that called
+    schedule() before, schedule_tail() for a thread's first run.
+*/
 void schedule(void) {
-    // Check if there are any threads in the run queue
+    unsigned long flags;
+    spin_lock_irqsave(&rq_lock, flags);
     thread_t *prev_thread = current_thread;
-    thread_t *next_thread = thread_dequeue();
-    if (next_thread != NULL) {
-        // uart_send_string("Switching to thread: ");
-        // uart_send_num(next_thread->id, "hex");
-        // uart_send_string(", State: ");
-        // uart_send_num(next_thread->state, "dec");
-        // uart_send_string("\r\n");
-        
-    } else {
-        next_thread = thread_create(idle, LOW_PRIORITY, NULL, 0); // Create a new idle thread if no threads are available
+    unsigned long now = read_cntpct();
+    int preempted = prev_thread->state == THREAD_RUNNING; // otherwise it blocked or exited
+    if (prev_thread->policy != SCHED_NORMAL) {
+        rt_update_curr(prev_thread); // charge the RT budget
+    } else if (sched_class == &fair_sched_class && prev_thread != idle_thread) {
+        update_curr(prev_thread); // blocking or exiting too, not only preemption
+        update_min_vruntime();
+    }
+    if (prev_thread->state == THREAD_RUNNING && prev_thread != idle_thread) {
+        prev_thread->state = THREAD_READY; // Set the current thread state to ready
+        prev_thread->last_queued = now;
+        class_of(prev_thread)->enqueue(prev_thread); // back to the tail of its priority level
     }
+    need_resched = 0;
 
+    // pick the first thread of the highest non-empty priority level
+    thread_t *next_thread = pick_next_thread();
+    if (next_thread == NULL) {
+        next_thread = idle_thread; // nothing runnable
+    }
 
     next_thread->state = THREAD_RUNNING; // Set the next thread state to running
-    if (current_thread->state != THREAD_DEAD) {
-        current_thread->state = THREAD_READY; // Set the current thread state to ready
-        thread_enqueue(current_thread); // Add the current thread back to the run queue
-    } 
-
+    next_thread->exec_start = read_cntpct();
+    next_thread->slice_start = next_thread->exec_start;
+    if (next_thread->wakeup_stamp != 0) { // woken RT thread: how long did it wait for the CPU
+        unsigned long latency = next_thread->exec_start - next_thread->wakeup_stamp;
+        if (latency > rt_max_wakeup_latency) {
+            rt_max_wakeup_latency = latency;
+        }
+        next_thread->wakeup_stamp = 0;
+    }
+    if (next_thread != prev_thread) {
+        prev_thread->run_ticks += now - prev_thread->last_arrival;
+        if (preempted) {
+            prev_thread->nr_involuntary++;
+        } else {
+            prev_thread->nr_voluntary++;
+        }
+        if (next_thread->last_queued != 0) {
+            unsigned long wait = now - next_thread->last_queued;
+            next_thread->wait_ticks += wait;
+            schedstat_record(&rq_latency_hist, wait);
+        }
+        next_thread->last_arrival = now;
+        set_task_cpu(next_thread, smp_processor_id());
+    }
+    next_thread->last_queued = 0;
     current_thread = next_thread; // Update the current thread
-    switch_to(prev_thread->context, next_thread->context, (void *)vtop((unsigned long)next_thread->pgd)); // Switch to the next thread
+    fpsimd_switch(next_thread);   // EL0 traps on FP/SIMD unless its registers are live
+    tick_program_next();          // slice end of the new thread, or no tick at all
+
+    if (next_thread != prev_thread) { // otherwise still the best candidate, no switch needed
+        switch_stamp[smp_processor_id()] = read_cntpct();
+        switch_to(prev_thread->context, next_thread->context, (void *)vtop((unsigned long)next_thread->pgd)); // Switch to the next thread
+        schedstat_record(&switch_cost_hist, read_cntpct() - switch_stamp[smp_processor_id()]);
+    }
+    spin_unlock_irqrestore(&rq_lock, flags);
+}
+
+// preemption point for long loops in system calls, which interrupts don't preempt
+void cond_resched(void) {
+    if (need_resched) {
+        schedule(); // still runnable, so we are queued again
+    }
+}
+
+// first code of a new thread after switch_to(): finish the switch
+void schedule_tail(void) {
+    schedstat_record(&switch_cost_hist, read_cntpct() - switch_stamp[smp_processor_id()]);
+    acct_return_to_user(current_thread); // a forked child goes straight to EL0
+    spin_unlock(&rq_lock); // interrupts stay masked until the thread unmasks them
+}
+
+// timer softirq: decide whether the running thread is preempted when the interrupt returns
+void sched_tick(void) {
+    unsigned long flags;
+    int resched;
+    spin_lock_irqsave(&rq_lock, flags);
+    rt_period_check();
+    if (current_thread == idle_thread) {
+        resched = sched_nr_running() > 0; // idle always yields
+    } else {
+        const struct sched_class *class = class_of(current_thread);
+        resched = class->tick(current_thread); // the class wants to preempt the running thread
+        if (!resched && current_thread->policy == SCHED_NORMAL
+                && rt_run_queue.nr_running > 0 && !rt_throttled) {
+            resched = 1; // the RT budget is back: queued RT threads run first
+        }
+        unsigned long slice_end = class->slice_end(current_thread);
+        if (!resched && slice_end != TIMER_NO_EVENT && (long)(read_cntpct() - slice_end) >= 0) {
+            current_thread->slice_start = read_cntpct(); // keeps the CPU: start a new slice
+        }
+    }
+    if (resched) {
+        need_resched = 1;
+    }
+    spin_unlock_irqrestore(&rq_lock, flags);
+}
+
+/*
+    Absolute cntpct at which the running thread's timeslice ends, or
+    TIMER_NO_EVENT if it may run until it blocks (SCHED_FIFO).
+*/
+unsigned long sched_slice_end(void) {
+    thread_t *curr = current_thread;
+    unsigned long end = class_of(curr)->slice_end(curr);
+    if (curr->policy == SCHED_NORMAL && rt_run_queue.nr_running > 0) {
+        // throttled RT threads get the CPU back when the period ends
+        unsigned long period_end = rt_period_start + us_to_ticks(rt_period_us);
+        if (end == TIMER_NO_EVENT || (long)(period_end - end) < 0) {
+            end = period_end;
+        }
+    }
+    return end;
+}
+
+unsigned int sched_nr_running(void) {
+    return rt_run_queue.nr_running + sched_class->nr_running();
 }
 
 void foo() {
@@ -237,79 +703,161 @@ void foo() {
 
 void idle() {
     while (1) {
-        // uart_send_string("Idle thread running\n");
-        // kill_zombies();
-        schedule();
+        if (sched_nr_running() > 0) {
+            schedule();
+        } else {
+            cpu_do_idle(); // sleep until the next interrupt
+        }
     }
 }
 
+void cpu_do_idle(void) {
+    asm volatile (
+        "wfi\n"            // wakes on a pending IRQ even while it is masked
+        "msr daifclr, 2\n" // take the IRQ that woke us
+        "isb\n"
+        "msr daifset, 2\n"
+    );
+}
+
 void kill_zombies() {
     // Check if there are any zombies in the zombies queue
     // uart_send_string("Killing zombies\n");
-    while (zombies_queue.head != NULL) {
+    while (1) {
+        unsigned long flags;
+        spin_lock_irqsave(&zombie_lock, flags);
         thread_t *zombie = zombies_queue.head;
-        zombies_queue.head = zombie->next;
+        if (zombie != NULL) {
+            zombies_queue.head = zombie->next;
+        }
 
         // If the queue is now empty, set the tail to NULL
         if (zombies_queue.head == NULL) {
             zombies_queue.tail = NULL;
         }
+        spin_unlock_irqrestore(&zombie_lock, flags);
+        if (zombie == NULL) {
+            break;
+        }
+
+        spin_lock_irqsave(&rq_lock, flags);
+        int on_cpu = zombie == current_thread; // still switching away from its stack
+        spin_unlock_irqrestore(&rq_lock, flags);
+        if (on_cpu) {
+            zombie_push(zombie); // retry on the next wakeup
+            break;
+        }
 
         // Free the memory allocated for the zombie thread
-        free(zombie->usr_stack_base); // Free the stack
-        free(zombie->kernel_stack_base); // Free the kernel stack
-        free(zombie->user_prog); // Free the user program
-        free(zombie);
+        if (zombie->user_prog != NULL) {
+            free(zombie->user_prog); // Free the user program
+        }
+        fpsimd_release(zombie);
+        free_page_tables(zombie->pgd); // Free the page tables, not the pages they map
+        detach_pid(zombie);
+        free_pid(zombie->id); // the id can be handed out again
+        thread_free(zombie); // keeps the stacks for the next thread
     }
 }
 
-void thread_enqueue(thread_t *t) {
-    if (run_queue[t->priority].head == NULL) {
-        run_queue[t->priority].head = t;
-        run_queue[t->priority].tail = t;
+static inline int highest_prio(unsigned long bitmap) {
+    return 63 - __builtin_clzl(bitmap); // single CLZ instruction on aarch64
+}
+
+// --- priority array, shared by the rr and rt classes ---
+static void prio_array_add(prio_array_t *array, thread_t *t, int prio, int at_head) {
+    thread_queue_t *q = &array->queue[prio];
+    if (q->head == NULL) {
+        q->head = t;
+        q->tail = t;
         t->prev = NULL;
         t->next = NULL;
+    } else if (at_head) {
+        t->prev = NULL;
+        t->next = q->head;
+        q->head->prev = t;
+        q->head = t;
     } else {
-        t->prev = run_queue[t->priority].tail;
-        run_queue[t->priority].tail->next = t;
-        run_queue[t->priority].tail = t;
+        t->prev = q->tail;
+        q->tail->next = t;
+        q->tail = t;
         t->next = NULL;
     }
+    array->bitmap |= 1UL << prio; // mark the level as non-empty
+    array->nr_running++;
 }
 
-
-thread_t *thread_dequeue() {
-    for (int i = HIGH_PRIORITY; i >= LOW_PRIORITY; i--) {
-        if (run_queue[i].head != NULL) {
-            thread_t *t = run_queue[i].head;
-            run_queue[i].head = t->next;
-            if (run_queue[i].head != NULL) {
-                run_queue[i].head->prev = NULL;
-            } else {
-                run_queue[i].tail = NULL; // If the queue is now empty, set the tail to NULL
-            }
-            return t;
-        }
+static thread_t *prio_array_pop(prio_array_t *array) {
+    if (array->bitmap == 0) {
+        return NULL; // nothing runnable
+    }
+    int prio = highest_prio(array->bitmap);
+    thread_queue_t *q = &array->queue[prio];
+    thread_t *t = q->head;
+    q->head = t->next;
+    if (q->head != NULL) {
+        q->head->prev = NULL;
+    } else {
+        q->tail = NULL; // If the queue is now empty, set the tail to NULL
+        array->bitmap &= ~(1UL << prio);
     }
-    return NULL;
+    t->next = NULL;
+    t->prev = NULL;
+    array->nr_running--;
+    return t;
 }
 
-void thread_remove_from_queue(thread_t *t) {
+static void prio_array_del(prio_array_t *array, thread_t *t, int prio) {
+    thread_queue_t *q = &array->queue[prio];
     if (t->prev != NULL) {
         t->prev->next = t->next;
     } else {
-        run_queue[t->priority].head = t->next;
+        q->head = t->next;
     }
     if (t->next != NULL) {
         t->next->prev = t->prev;
     } else {
-        run_queue[t->priority].tail = t->prev;
+        q->tail = t->prev;
     }
+    if (q->head == NULL) {
+        array->bitmap &= ~(1UL << prio);
+    }
+    t->next = NULL;
+    t->prev = NULL;
+    array->nr_running--;
 }
 
-void print_thread_info() {
-    for (int i = HIGH_PRIORITY; i >= LOW_PRIORITY + 1; i--) {
-        thread_t *t = run_queue[i].head;
+// --- round-robin priority class ---
+static void rr_enqueue(thread_t *t) {
+    prio_array_add(&run_queue, t, t->priority, 0);
+}
+
+static thread_t *rr_pick_next(void) {
+    return prio_array_pop(&run_queue);
+}
+
+static void rr_remove(thread_t *t) {
+    prio_array_del(&run_queue, t, t->priority);
+}
+
+static unsigned long rr_slice_end(thread_t *curr) {
+    return curr->slice_start + (read_cntfrq() >> 5); // 1/32 sec
+}
+
+static int rr_tick(thread_t *curr) {
+    return (long)(read_cntpct() - rr_slice_end(curr)) >= 0; // rotate when the slice is over
+}
+
+static unsigned int rr_nr_running(void) {
+    return run_queue.nr_running;
+}
+
+static void prio_array_print(prio_array_t *array) {
+    unsigned long bitmap = array->bitmap;
+    while (bitmap != 0) {
+        int i = highest_prio(bitmap);
+        bitmap &= ~(1UL << i);
+        thread_t *t = array->queue[i].head;
         uart_send_string("=== Priority: ");
         uart_send_num(i, "dec");
         uart_send_string(" ===\n");
@@ -324,4 +872,444 @@ void print_thread_info() {
             t = t->next;
         }
     }
-}
\ No newline at end of file
+}
+
+static void rr_print(void) {
+    prio_array_print(&run_queue);
+}
+
+const struct sched_class rr_sched_class = {
+    .name = "rr",
+    .enqueue = rr_enqueue,
+    .pick_next = rr_pick_next,
+    .remove = rr_remove,
+    .tick = rr_tick,
+    .slice_end = rr_slice_end,
+    .nr_running = rr_nr_running,
+    .print = rr_print,
+};
+
+// --- fair (virtual runtime) class ---
+#define NICE_0_WEIGHT       1024
+#define SCHED_LATENCY_US    6000  // period in which every thread runs once
+#define SCHED_MIN_GRAN_US   750   // lower bound of a timeslice
+
+// weight of nice -20 .. 19; each step is ~10% of CPU time
+static const unsigned int nice_to_weight[40] = {
+    88761, 71755, 56483, 46273, 36291,
+    29154, 23254, 18705, 14949, 11916,
+     9548,  7620,  6100,  4904,  3906,
+     3121,  2501,  1991,  1586,  1277,
+     1024,   820,   655,   526,   423,
+      335,   272,   215,   172,   137,
+      110,    87,    70,    56,    45,
+       36,    29,    23,    18,    15,
+};
+
+static inline unsigned long thread_weight(thread_t *t) {
+    int nice = 19 - (t->priority * 39) / HIGH_PRIORITY; // MEDIUM_PRIORITY -> nice 0
+    return nice_to_weight[nice + 20];
+}
+
+static inline unsigned long max_vruntime(unsigned long a, unsigned long b) {
+    return ((long)(a - b) > 0) ? a : b; // wrap-safe comparison
+}
+
+// charge the running thread for the time since it was last accounted
+static void update_curr(thread_t *curr) {
+    unsigned long now = read_cntpct();
+    unsigned long delta = now - curr->exec_start;
+    curr->exec_start = now;
+    curr->vruntime += delta * NICE_0_WEIGHT / thread_weight(curr);
+}
+
+static void update_min_vruntime(void) {
+    unsigned long vruntime = cfs_run_queue.min_vruntime;
+    if (cfs_run_queue.leftmost != NULL) {
+        vruntime = rb_entry(cfs_run_queue.leftmost, thread_t, run_node)->vruntime;
+    }
+    if (current_thread != NULL && current_thread != idle_thread
+            && current_thread->policy == SCHED_NORMAL
+            && current_thread->state == THREAD_RUNNING
+            && (long)(current_thread->vruntime - vruntime) < 0) {
+        vruntime = current_thread->vruntime;
+    }
+    cfs_run_queue.min_vruntime = max_vruntime(cfs_run_queue.min_vruntime, vruntime);
+}
+
+static void fair_enqueue(thread_t *t) {
+    if (t != current_thread) { // current was charged by schedule()
+        // new or woken thread: don't let a long sleep bank unbounded credit
+        unsigned long floor = cfs_run_queue.min_vruntime - us_to_ticks(SCHED_LATENCY_US) / 2;
+        t->vruntime = max_vruntime(t->vruntime, floor);
+    }
+
+    rb_node_t **link = &cfs_run_queue.tasks.node, *parent = NULL;
+    int leftmost = 1;
+    while (*link != NULL) {
+        parent = *link;
+        if ((long)(t->vruntime - rb_entry(parent, thread_t, run_node)->vruntime) < 0) {
+            link = &parent->left;
+        } else {
+            link = &parent->right; // equal keys go right: FIFO among ties
+            leftmost = 0;
+        }
+    }
+    rb_link_node(&t->run_node, parent, link);
+    rb_insert_color(&t->run_node, &cfs_run_queue.tasks);
+    if (leftmost) {
+        cfs_run_queue.leftmost = &t->run_node;
+    }
+    cfs_run_queue.load += thread_weight(t);
+    cfs_run_queue.nr_running++;
+}
+
+static void fair_remove(thread_t *t) {
+    if (cfs_run_queue.leftmost == &t->run_node) {
+        cfs_run_queue.leftmost = rb_next(&t->run_node);
+    }
+    rb_erase(&t->run_node, &cfs_run_queue.tasks);
+    cfs_run_queue.load -= thread_weight(t);
+    cfs_run_queue.nr_running--;
+}
+
+static thread_t *fair_pick_next(void) {
+    if (cfs_run_queue.leftmost == NULL) {
+        return NULL; // nothing runnable
+    }
+    thread_t *t = rb_entry(cfs_run_queue.leftmost, thread_t, run_node);
+    fair_remove(t);
+    update_min_vruntime();
+    return t;
+}
+
+// timeslice proportional to the thread's share of the total weight
+static unsigned long fair_timeslice(thread_t *t) {
+    unsigned long nr = cfs_run_queue.nr_running + 1;
+    unsigned long period = us_to_ticks(SCHED_LATENCY_US);
+    if (nr * SCHED_MIN_GRAN_US > SCHED_LATENCY_US) {
+        period = us_to_ticks(nr * SCHED_MIN_GRAN_US); // stretch the period
+    }
+    unsigned long weight = thread_weight(t);
+    unsigned long slice = period * weight / (cfs_run_queue.load + weight);
+    unsigned long min_gran = us_to_ticks(SCHED_MIN_GRAN_US);
+    return slice < min_gran ? min_gran : slice;
+}
+
+static unsigned long fair_slice_end(thread_t *curr) {
+    return curr->slice_start + fair_timeslice(curr);
+}
+
+static unsigned int fair_nr_running(void) {
+    return cfs_run_queue.nr_running;
+}
+
+static int fair_tick(thread_t *curr) {
+    update_curr(curr);
+    update_min_vruntime();
+    if (cfs_run_queue.leftmost == NULL) {
+        return 0; // nobody else wants the CPU
+    }
+    if (read_cntpct() - curr->slice_start < fair_timeslice(curr)) {
+        return 0; // slice not used up yet
+    }
+    thread_t *next = rb_entry(cfs_run_queue.leftmost, thread_t, run_node);
+    return (long)(curr->vruntime - next->vruntime) > 0;
+}
+
+static void fair_print(void) {
+    uart_send_string("=== Fair run queue, min_vruntime: ");
+    uart_send_num(cfs_run_queue.min_vruntime, "dec");
+    uart_send_string(" ===\n");
+    for (rb_node_t *node = rb_first(&cfs_run_queue.tasks); node != NULL; node = rb_next(node)) {
+        thread_t *t = rb_entry(node, thread_t, run_node);
+        uart_send_string("    Thread ID: ");
+        uart_send_num(t->id, "dec");
+        uart_send_string(" Priority: ");
+        uart_send_num(t->priority, "dec");
+        uart_send_string(" Weight: ");
+        uart_send_num(thread_weight(t), "dec");
+        uart_send_string(" vruntime: ");
+        uart_send_num(t->vruntime, "dec");
+        uart_send_string("\n");
+    }
+}
+
+const struct sched_class fair_sched_class = {
+    .name = "cfs",
+    .enqueue = fair_enqueue,
+    .pick_next = fair_pick_next,
+    .remove = fair_remove,
+    .tick = fair_tick,
+    .slice_end = fair_slice_end,
+    .nr_running = fair_nr_running,
+    .print = fair_print,
+};
+
+// --- real-time class: SCHED_FIFO and SCHED_RR, one list per rt_priority ---
+#define RT_RR_TIMESLICE_US  100000
+
+static void rt_period_check(void) {
+    unsigned long now = read_cntpct();
+    if (now - rt_period_start >= us_to_ticks(rt_period_us)) {
+        rt_period_start = now; // new period, fresh budget
+        rt_time = 0;
+        rt_throttled = 0;
+    }
+}
+
+// charge the running RT thread and throttle the class once the budget is used up
+static void rt_update_curr(thread_t *curr) {
+    unsigned long now = read_cntpct();
+    rt_time += now - curr->exec_start;
+    curr->exec_start = now;
+    if (rt_runtime_us < rt_period_us && rt_time >= us_to_ticks(rt_runtime_us)) {
+        rt_throttled = 1;
+    }
+}
+
+static inline int rt_slice_expired(thread_t *t) {
+    return t->policy == SCHED_RR && read_cntpct() - t->slice_start >= us_to_ticks(RT_RR_TIMESLICE_US);
+}
+
+static void rt_enqueue(thread_t *t) {
+    // a preempted thread keeps its place at the head of its level, unless its RR slice is over
+    int at_head = t == current_thread && need_resched && !rt_slice_expired(t);
+    prio_array_add(&rt_run_queue, t, t->rt_priority, at_head);
+}
+
+static thread_t *rt_pick_next(void) {
+    return prio_array_pop(&rt_run_queue);
+}
+
+static void rt_remove(thread_t *t) {
+    prio_array_del(&rt_run_queue, t, t->rt_priority);
+}
+
+static unsigned long rt_slice_end(thread_t *curr) {
+    unsigned long end = TIMER_NO_EVENT; // FIFO: run until it blocks or is preempted
+    if (curr->policy == SCHED_RR && rt_run_queue.queue[curr->rt_priority].head != NULL) {
+        end = curr->slice_start + us_to_ticks(RT_RR_TIMESLICE_US);
+    }
+    if (rt_runtime_us < rt_period_us && sched_class->nr_running() > 0) {
+        // normal threads are waiting: stop at the end of the budget
+        unsigned long budget = us_to_ticks(rt_runtime_us);
+        unsigned long throttle = curr->exec_start + (rt_time < budget ? budget - rt_time : 0);
+        if (end == TIMER_NO_EVENT || (long)(throttle - end) < 0) {
+            end = throttle;
+        }
+    }
+    return end;
+}
+
+static int rt_tick(thread_t *curr) {
+    rt_update_curr(curr);
+    if (rt_throttled && sched_class->nr_running() > 0) {
+        return 1; // out of budget: let the normal threads run
+    }
+    if (rt_run_queue.bitmap != 0 && highest_prio(rt_run_queue.bitmap) > curr->rt_priority) {
+        return 1;
+    }
+    if (rt_run_queue.queue[curr->rt_priority].head != NULL) {
+        return rt_slice_expired(curr); // rotate among equal priorities once the slice is over
+    }
+    return 0;
+}
+
+static unsigned int rt_nr_running(void) {
+    return rt_run_queue.nr_running;
+}
+
+static void rt_print(void) {
+    uart_send_string("=== RT run queue, throttled: ");
+    uart_send_num(rt_throttled, "dec");
+    uart_send_string(" max wakeup latency (us): ");
+    uart_send_num(ticks_to_us(rt_max_wakeup_latency), "dec");
+    uart_send_string(" ===\n");
+    prio_array_print(&rt_run_queue);
+}
+
+const struct sched_class rt_sched_class = {
+    .name = "rt",
+    .enqueue = rt_enqueue,
+    .pick_next = rt_pick_next,
+    .remove = rt_remove,
+    .tick = rt_tick,
+    .slice_end = rt_slice_end,
+    .nr_running = rt_nr_running,
+    .print = rt_print,
+};
+
+// --- class independent interface, each call takes rq_lock ---
+
+// a woken RT thread preempts normal threads and lower RT priorities
+static void check_preempt_curr(thread_t *t) {
+    thread_t *curr = current_thread;
+    if (t->policy == SCHED_NORMAL || rt_throttled) {
+        return;
+    }
+    if (curr == idle_thread || curr->policy == SCHED_NORMAL || t->rt_priority > curr->rt_priority) {
+        need_resched = 1;
+    }
+}
+
+static void enqueue_locked(thread_t *t) {
+    set_task_cpu(t, select_task_rq(t));
+    t->last_queued = read_cntpct();
+    class_of(t)->enqueue(t);
+    check_preempt_curr(t);
+    if (tick_stopped) {
+        tick_program_next(); // someone to share the CPU with: restart the tick
+    }
+}
+
+void thread_enqueue(thread_t *t) {
+    unsigned long flags;
+    spin_lock_irqsave(&rq_lock, flags);
+    enqueue_locked(t);
+    spin_unlock_irqrestore(&rq_lock, flags);
+}
+
+thread_t *thread_dequeue() {
+    unsigned long flags;
+    spin_lock_irqsave(&rq_lock, flags);
+    thread_t *t = pick_next_thread();
+    spin_unlock_irqrestore(&rq_lock, flags);
+    return t;
+}
+
+void thread_remove_from_queue(thread_t *t) {
+    unsigned long flags;
+    spin_lock_irqsave(&rq_lock, flags);
+    class_of(t)->remove(t);
+    spin_unlock_irqrestore(&rq_lock, flags);
+}
+
+int thread_wakeup(thread_t *t) {
+    unsigned long flags;
+    int woken = 0;
+    spin_lock_irqsave(&rq_lock, flags);
+    if (t->state == THREAD_WAITING) {
+        if (t == current_thread) {
+            t->state = THREAD_RUNNING; // not switched out yet: just cancel the sleep
+        } else {
+            t->state = THREAD_READY;
+            if (t->policy != SCHED_NORMAL) {
+                t->wakeup_stamp = read_cntpct(); // start of the wakeup latency
+            }
+            enqueue_locked(t);
+        }
+        woken = 1;
+    }
+    spin_unlock_irqrestore(&rq_lock, flags);
+    return woken;
+}
+
+int thread_set_priority(thread_t *t, int priority) {
+    if (priority < LOW_PRIORITY || priority > HIGH_PRIORITY) {
+        return -1; // Invalid priority level
+    }
+    unsigned long flags;
+    spin_lock_irqsave(&rq_lock, flags);
+    if (t->state == THREAD_READY) { // queued: move it to the new level
+        class_of(t)->remove(t);
+        t->priority = priority;
+        class_of(t)->enqueue(t);
+    } else {
+        t->priority = priority;
+    }
+    spin_unlock_irqrestore(&rq_lock, flags);
+    return 0;
+}
+
+/*
+    Move t between SCHED_NORMAL and the RT policies. rt_priority must be
+    0 for SCHED_NORMAL and RT_PRIO_MIN..RT_PRIO_MAX otherwise.
+*/
+int thread_setscheduler(thread_t *t, int policy, int rt_priority) {
+    if (policy == SCHED_NORMAL) {
+        if (rt_priority != 0) {
+            return -1;
+        }
+    } else if (policy == SCHED_FIFO || policy == SCHED_RR) {
+        if (rt_priority < RT_PRIO_MIN || rt_priority > RT_PRIO_MAX) {
+            return -1;
+        }
+    } else {
+        return -1; // unknown policy
+    }
+    if (t == idle_thread) {
+        return -1;
+    }
+
+    unsigned long flags;
+    spin_lock_irqsave(&rq_lock, flags);
+    if (t->state == THREAD_DEAD) {
+        spin_unlock_irqrestore(&rq_lock, flags);
+        return -1;
+    }
+    if (t == current_thread && t->policy != SCHED_NORMAL) {
+        rt_update_curr(t); // charge the time spent under the old policy
+    }
+    if (t->state == THREAD_READY) { // queued: move it to the new class
+        class_of(t)->remove(t);
+        t->policy = policy;
+        t->rt_priority = rt_priority;
+        class_of(t)->enqueue(t);
+        check_preempt_curr(t);
+    } else {
+        t->policy = policy;
+        t->rt_priority = rt_priority;
+    }
+    int resched = 0;
+    if (t == current_thread) {
+        t->exec_start = read_cntpct();
+        t->slice_start = t->exec_start;
+        // lowered: a queued RT thread may outrank us now
+        if (rt_run_queue.bitmap != 0 && !rt_throttled
+                && (policy == SCHED_NORMAL || highest_prio(rt_run_queue.bitmap) > rt_priority)) {
+            need_resched = 1;
+        }
+        resched = need_resched;
+        tick_program_next(); // the slice end depends on the policy
+    }
+    spin_unlock_irqrestore(&rq_lock, flags);
+    if (resched) {
+        schedule();
+    }
+    return 0;
+}
+
+/*
+    Restrict t to the cores in mask. The mask must contain an online core;
+    a thread queued on a core it may no longer use is moved right away,
+    the running thread when it is next switched out.
+*/
+int thread_set_affinity(thread_t *t, unsigned long mask) {
+    mask &= CPU_MASK_ALL;
+    if ((mask & cpu_online_mask) == 0 || t == idle_thread) {
+        return -1;
+    }
+    unsigned long flags;
+    spin_lock_irqsave(&rq_lock, flags);
+    t->cpus_allowed = mask;
+    if (!(mask & (1UL << t->cpu))) {
+        if (t == current_thread) {
+            need_resched = 1;
+        } else if (t->state == THREAD_READY) {
+            set_task_cpu(t, select_task_rq(t));
+        }
+    }
+    spin_unlock_irqrestore(&rq_lock, flags);
+    return 0;
+}
+
+void print_thread_info() {
+    unsigned long flags;
+    spin_lock_irqsave(&rq_lock, flags);
+    if (rt_run_queue.nr_running > 0) {
+        rt_sched_class.print();
+    }
+    sched_class->print();
+    spin_unlock_irqrestore(&rq_lock, flags);
+}
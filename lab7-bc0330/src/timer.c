@@ -0,0 +1,212 @@
+#include <stddef.h>
+#include "exception_handler.h"
+#include "mini_uart.h"
+#include "softirq.h"
+#include "spinlock.h"
+#include "thread.h"
+#include "timer.h"
+
+/*
+    One-shot use of the EL1 physical timer (CNTP): instead of a fixed
+    periodic tick, the compare value is set to the next event that needs
+    the CPU (timeslice end or earliest timer), and the timer is switched
+    off when there is none.
+*/
+
+int tick_stopped = 0;
+
+static timer_event_t *timer_heap[MAX_TIMERS]; // min-heap on expires
+static int timer_count = 0;
+static DEFINE_SPINLOCK(timer_lock);           // protects timer_heap and the index of pending timers
+
+static inline int timer_before(timer_event_t *a, timer_event_t *b) {
+    return (long)(a->expires - b->expires) < 0; // wrap-safe
+}
+
+static inline void heap_set(int i, timer_event_t *timer) {
+    timer_heap[i] = timer;
+    timer->index = i;
+}
+
+static void sift_up(int i) {
+    timer_event_t *timer = timer_heap[i];
+    while (i > 0) {
+        int parent = (i - 1) / 2;
+        if (!timer_before(timer, timer_heap[parent])) {
+            break;
+        }
+        heap_set(i, timer_heap[parent]);
+        i = parent;
+    }
+    heap_set(i, timer);
+}
+
+static void sift_down(int i) {
+    timer_event_t *timer = timer_heap[i];
+    while (1) {
+        int child = 2 * i + 1;
+        if (child >= timer_count) {
+            break;
+        }
+        if (child + 1 < timer_count && timer_before(timer_heap[child + 1], timer_heap[child])) {
+            child++; // the earlier of the two children
+        }
+        if (!timer_before(timer_heap[child], timer)) {
+            break;
+        }
+        heap_set(i, timer_heap[child]);
+        i = child;
+    }
+    heap_set(i, timer);
+}
+
+static void heap_remove(int i) {
+    timer_heap[i]->index = -1;
+    timer_count--;
+    if (i == timer_count) {
+        return; // removed the last slot
+    }
+    timer_event_t *moved = timer_heap[timer_count];
+    heap_set(i, moved); // fill the hole with the last slot
+    sift_down(i);
+    sift_up(moved->index);
+}
+
+void init_timer(timer_event_t *timer, void (*callback)(void *data), void *data) {
+    timer->expires = 0;
+    timer->callback = callback;
+    timer->data = data;
+    timer->index = -1;
+}
+
+int add_timer(timer_event_t *timer) {
+    unsigned long flags;
+    spin_lock_irqsave(&timer_lock, flags);
+    if (timer_pending(timer)) {
+        heap_remove(timer->index); // re-arm
+    }
+    if (timer_count == MAX_TIMERS) {
+        spin_unlock_irqrestore(&timer_lock, flags);
+        uart_send_string("[ERROR | TIMER] Too many pending timers\r\n");
+        return -1;
+    }
+    timer_heap[timer_count] = timer;
+    timer->index = timer_count++;
+    sift_up(timer->index);
+    int earliest = timer_heap[0] == timer;
+    spin_unlock(&timer_lock);
+    if (earliest) {
+        tick_program_next(); // new earliest event
+    }
+    enable_interrupt(flags);
+    return 0;
+}
+
+int del_timer(timer_event_t *timer) {
+    unsigned long flags;
+    spin_lock_irqsave(&timer_lock, flags);
+    int pending = timer_pending(timer);
+    if (pending) {
+        heap_remove(timer->index);
+    }
+    spin_unlock_irqrestore(&timer_lock, flags);
+    return pending; // 1 if the timer had not fired yet
+}
+
+int mod_timer(timer_event_t *timer, unsigned long expires) {
+    timer->expires = expires;
+    return add_timer(timer);
+}
+
+void run_timers(void) {
+    unsigned long now = read_cntpct();
+    while (1) {
+        unsigned long flags;
+        spin_lock_irqsave(&timer_lock, flags);
+        if (timer_count == 0 || (long)(timer_heap[0]->expires - now) > 0) {
+            spin_unlock_irqrestore(&timer_lock, flags);
+            break;
+        }
+        timer_event_t *timer = timer_heap[0];
+        heap_remove(0);
+        spin_unlock_irqrestore(&timer_lock, flags);
+        timer->callback(timer->data); // unlocked: callbacks may re-arm timers
+    }
+}
+
+// TIMER_SOFTIRQ, raised by the timer interrupt after it stopped the timer
+static void run_timer_softirq(void) {
+    run_timers();        // expired events first: they may wake threads
+    sched_tick();
+    tick_program_next(); // one-shot: arm the next event (or stop the tick)
+}
+
+void init_timers(void) {
+    open_softirq(TIMER_SOFTIRQ, run_timer_softirq);
+}
+
+unsigned long timer_next_expiry(void) {
+    unsigned long flags;
+    spin_lock_irqsave(&timer_lock, flags);
+    unsigned long expires = timer_count > 0 ? timer_heap[0]->expires : TIMER_NO_EVENT;
+    spin_unlock_irqrestore(&timer_lock, flags);
+    return expires;
+}
+
+static void process_timeout(void *data) {
+    thread_wakeup((thread_t *)data);
+}
+
+/*
+    Sleep for at most timeout counter ticks. The caller sets the thread
+    state before calling (THREAD_WAITING to block). Returns the ticks left
+    if woken early, 0 if the timeout expired.
+*/
+unsigned long schedule_timeout(unsigned long timeout) {
+    timer_event_t timer;
+    unsigned long expires = read_cntpct() + timeout;
+
+    init_timer(&timer, process_timeout, current_thread);
+    timer.expires = expires;
+    add_timer(&timer);
+    schedule();
+    del_timer(&timer); // woken by something else
+
+    long left = (long)(expires - read_cntpct());
+    return left > 0 ? left : 0;
+}
+
+void timer_program(unsigned long deadline) {
+    asm volatile (
+        "msr cntp_cval_el0, %0\n" // absolute expiry time
+        "mov x9, 1\n"
+        "msr cntp_ctl_el0, x9\n"  // enable, interrupt unmasked
+        : /* no output */
+        : "r" (deadline)
+        : "x9"
+    );
+}
+
+void timer_stop(void) {
+    asm volatile (
+        "msr cntp_ctl_el0, xzr\n" // disable: also drops the pending interrupt
+    );
+}
+
+void tick_program_next(void) {
+    unsigned long deadline = timer_next_expiry();
+    if (sched_nr_running() > 0) {
+        unsigned long slice_end = sched_slice_end(); // someone is waiting for the CPU
+        if (slice_end != TIMER_NO_EVENT && (deadline == TIMER_NO_EVENT || (long)(slice_end - deadline) < 0)) {
+            deadline = slice_end;
+        }
+    }
+
+    if (deadline == TIMER_NO_EVENT) {
+        timer_stop(); // a single runnable thread and no timers: no tick
+        tick_stopped = 1;
+        return;
+    }
+    tick_stopped = 0;
+    timer_program(deadline);
+}
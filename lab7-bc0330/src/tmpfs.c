@@ -1,6 +1,7 @@
 #include <stddef.h>
 #include "allocator.h"
 #include "mini_uart.h"
+#include "poll.h"
 #include "tmpfs.h"
 #include "utils.h"
 #include "vfs.h"
@@ -10,12 +11,18 @@ static int read(struct file* file, void* buf, size_t len);
 static int open(struct vnode* file_node, struct file** target);
 static int close(struct file* file);
 static long lseek64(struct file* file, long offset, int whence);
+static int pread(struct file* file, void* buf, size_t len, size_t pos);
+static int pwrite(struct file* file, const void* buf, size_t len, size_t pos);
+static unsigned int poll(struct file* file, struct poll_table* pt);
 struct file_operations tmpfs_fops = {
     .write = write,
     .read = read,
     .open = open,
     .close = close,
     .lseek64 = lseek64,
+    .pread = pread,
+    .pwrite = pwrite,
+    .poll = poll,
 };
 
 static int lookup(struct vnode* dir_node, struct vnode** target,
@@ -50,37 +57,59 @@ static int setup_mount(struct filesystem* fs, struct mount* mount) {
     return 0;
 }
 
-static int write(struct file* file, const void* buf, size_t len) {
+static int pwrite(struct file* file, const void* buf, size_t len, size_t pos) {
     struct vnode* node = file->vnode;
     tmpfs_internal_t* inter = (tmpfs_internal_t*)node->internal;
     if ((inter->mode & S_IFMT) != S_IFREG) {                       // Check if it's a regular file
         uart_send_string("[ERROR | Write] Not a regular file\r\n");
         return -1; // Not a regular file
     }
-    
-    size_t to_write = (file->f_pos + len > MAX_FILE_SIZE)?
-                     (MAX_FILE_SIZE - file->f_pos) : len;       // don't exceed max size
-    memcpy((char*)inter->content + file->f_pos, buf, to_write); 
-    file->f_pos += to_write;
-    inter->size = file->f_pos; // Update the size of the file
+    if (pos >= MAX_FILE_SIZE) {
+        return 0; // File is full
+    }
+
+    size_t to_write = (pos + len > MAX_FILE_SIZE)?
+                     (MAX_FILE_SIZE - pos) : len;       // don't exceed max size
+    memcpy((char*)inter->content + pos, buf, to_write);
+    if (pos + to_write > inter->size) {
+        inter->size = pos + to_write; // Grow the file; a write in the middle keeps the rest
+    }
     return (int)to_write;
 }
 
-static int read(struct file* file, void* buf, size_t len) {
+static int pread(struct file* file, void* buf, size_t len, size_t pos) {
     struct vnode* node = file->vnode;
     tmpfs_internal_t* inter = (tmpfs_internal_t*)node->internal;
     if ((inter->mode & S_IFMT) != S_IFREG) {                      // Check if it's a regular file
         uart_send_string("[ERROR | Read] Not a regular file\r\n");
         return -1; // Not a regular file
     }
-    
-    size_t to_read = (file->f_pos + len > inter->size)?
-                     (inter->size - file->f_pos) : len;       // don't exceed max size
-    memcpy(buf, (char*)inter->content + file->f_pos, to_read);
-    file->f_pos += to_read;
+    if (pos >= inter->size) {
+        return 0; // End of file
+    }
+
+    size_t to_read = (pos + len > inter->size)?
+                     (inter->size - pos) : len;       // don't exceed the file size
+    memcpy(buf, (char*)inter->content + pos, to_read);
     return (int)to_read;
 }
 
+static int write(struct file* file, const void* buf, size_t len) {
+    int bytes_written = pwrite(file, buf, len, file->f_pos);
+    if (bytes_written > 0) {
+        file->f_pos += bytes_written;
+    }
+    return bytes_written;
+}
+
+static int read(struct file* file, void* buf, size_t len) {
+    int bytes_read = pread(file, buf, len, file->f_pos);
+    if (bytes_read > 0) {
+        file->f_pos += bytes_read;
+    }
+    return bytes_read;
+}
+
 static int open(struct vnode* file_node, struct file** target) {
     return 0; // Open successful
 }
@@ -91,7 +120,12 @@ static int close(struct file* file) {
 }
 
 static long lseek64(struct file* file, long offset, int whence) {
-    return 0; // Seek successful
+    tmpfs_internal_t* inter = (tmpfs_internal_t*)file->vnode->internal;
+    return generic_file_lseek(file, offset, whence, inter->size, MAX_FILE_SIZE);
+}
+
+static unsigned int poll(struct file* file, struct poll_table* pt) {
+    return POLLIN | POLLOUT; // in memory, reads and writes never wait
 }
 
 static int lookup(struct vnode* dir_node, struct vnode** target,
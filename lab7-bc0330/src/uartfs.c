@@ -1,6 +1,8 @@
 #include <stddef.h>
 #include "allocator.h"
+#include "exception_handler.h"
 #include "mini_uart.h"
+#include "poll.h"
 #include "uartfs.h"
 #include "utils.h"
 #include "vfs.h"
@@ -10,12 +12,14 @@ static int read(struct file* file, void* buf, size_t len);
 static int open(struct vnode* file_node, struct file** target);
 static int close(struct file* file);
 static long lseek64(struct file* file, long offset, int whence);
+static unsigned int poll(struct file* file, struct poll_table* pt);
 struct file_operations uartfs_fops = {
     .write = write,
     .read = read,
     .open = open,
     .close = close,
     .lseek64 = lseek64,
+    .poll = poll,
 };
 
 static int lookup(struct vnode* dir_node, struct vnode** target,
@@ -82,7 +86,11 @@ static int read(struct file* file, void* buf, size_t len) {
         return -1; // Cannot read from a write-only file
     }
     for (int i = 0; i < len; ++i) {
-        ((char*)buf)[i] = uart_recv(); // Fill the buffer with received characters
+        int c = uart_getc();
+        if (c < 0) { // killed or signalled: what we have so far
+            return i > 0 ? i : -1;
+        }
+        ((char*)buf)[i] = c; // Fill the buffer with received characters
     }
     return len; // Return the number of bytes read
 }
@@ -97,7 +105,16 @@ static int close(struct file* file) {
 }
 
 static long lseek64(struct file* file, long offset, int whence) {
-    return 0; // Seek successful
+    return -1; // a stream, not seekable
+}
+
+static unsigned int poll(struct file* file, struct poll_table* pt) {
+    poll_wait(&uart_read_wait, pt); // woken by the RX interrupt's tasklet
+    unsigned int mask = POLLOUT;    // uart_send() only waits when the TX ring is full
+    if (read_front != read_rear) {
+        mask |= POLLIN;
+    }
+    return mask;
 }
 
 static int lookup(struct vnode* dir_node, struct vnode** target,
@@ -0,0 +1,245 @@
+#include <stddef.h>
+#include "allocator.h"
+#include "exception_handler.h"
+#include "mini_uart.h"
+#include "mmu.h"
+#include "thread.h"
+#include "timer.h"
+#include "uring.h"
+#include "utils.h"
+#include "vfs.h"
+#include "wait.h"
+
+// order our reads of the other side's index against the entries it covers
+#define ring_barrier() asm volatile ("dmb ish\n" : : : "memory")
+
+static int sq_pending(uring_t *ring) {
+    unsigned int queued = ring->page->sq_tail - ring->sq_head;
+    return queued != 0 && queued <= ring->entries;
+}
+
+static int cq_full(uring_t *ring) {
+    unsigned int used = ring->cq_tail - ring->page->cq_head;
+    return used >= ring->entries; // also catches a cq_head beyond cq_tail
+}
+
+static unsigned int cq_ready(uring_t *ring) {
+    return ring->cq_tail - ring->page->cq_head;
+}
+
+/*
+    Run one request against the owner's file table. The caller runs on the
+    owner's page tables, so addr is used as is, like the system calls do.
+    Slots are only touched through the fd_*() helpers, the owner changes
+    the table at the same time.
+*/
+static long uring_issue(uring_t *ring, struct uring_sqe *sqe) {
+    thread_t *owner = ring->owner;
+    if (sqe->opcode == URING_OP_NOP) {
+        return 0;
+    }
+    if (sqe->opcode == URING_OP_OPEN) {
+        struct file *file = NULL;
+        if (vfs_open((const char *)sqe->addr, sqe->len, &file) != 0) {
+            return -1;
+        }
+        int fd = fd_install(owner, file);
+        if (fd < 0) {
+            vfs_close(file); // no file descriptor is available
+        }
+        return fd;
+    }
+    if (sqe->opcode == URING_OP_CLOSE) {
+        struct file *file = fd_remove(owner, sqe->fd);
+        if (file == NULL) {
+            return -1; // Invalid file descriptor
+        }
+        return vfs_close(file) != 0 ? -1 : 0;
+    }
+
+    struct file *file = fd_get(owner, sqe->fd); // the owner may close fd while we sleep in the request
+    if (file == NULL) {
+        return -1; // Invalid file descriptor
+    }
+    long res;
+    switch (sqe->opcode) {
+        case URING_OP_READ: {
+            int bytes_read = vfs_read(file, (void *)sqe->addr, sqe->len);
+            res = bytes_read < 0 ? -1 : bytes_read;
+            break;
+        }
+        case URING_OP_WRITE: {
+            int bytes_written = vfs_write(file, (const void *)sqe->addr, sqe->len);
+            res = bytes_written < 0 ? -1 : bytes_written;
+            break;
+        }
+        default:
+            res = -1; // unknown opcode
+            break;
+    }
+    vfs_close(file);
+    return res;
+}
+
+// consume up to max submissions, returns how many were completed
+static unsigned int uring_submit(uring_t *ring, unsigned int max) {
+    struct uring_page *page = ring->page;
+    unsigned int mask = ring->entries - 1;
+    unsigned int done = 0;
+    while (done < max && sq_pending(ring) && !cq_full(ring)) {
+        ring_barrier(); // the entry was written before sq_tail
+        struct uring_sqe sqe = page->sqes[ring->sq_head & mask]; // user space may change it meanwhile
+        ring->sq_head++;
+        page->sq_head = ring->sq_head;
+
+        long res = uring_issue(ring, &sqe);
+        struct uring_cqe *cqe = &page->cqes[ring->cq_tail & mask];
+        cqe->user_data = sqe.user_data;
+        cqe->res = res;
+        ring_barrier(); // the completion is visible before cq_tail
+        ring->cq_tail++;
+        page->cq_tail = ring->cq_tail;
+        done++;
+    }
+    return done;
+}
+
+static int uring_has_work(uring_t *ring) {
+    return sq_pending(ring) && !cq_full(ring);
+}
+
+/*
+    SQPOLL thread. It borrows the owner's page tables so user addresses in
+    the entries work unchanged, and polls between other threads' turns
+    until it has been idle for idle_ticks.
+*/
+static void uring_sqpoll(void) {
+    thread_t *self = current_thread;
+    uring_t *ring = self->ring;
+    unsigned long *own_pgd = self->pgd;
+    self->pgd = ring->owner->pgd;
+    switch_pgd(self->pgd);
+
+    unsigned long idle_since = read_cntpct();
+    while (!ring->stop) {
+        self->cwd = ring->owner->cwd; // relative paths of URING_OP_OPEN
+        if (uring_submit(ring, ring->entries) != 0) {
+            wake_up(&ring->cq_wait);
+            idle_since = read_cntpct();
+        } else if (read_cntpct() - idle_since > ring->idle_ticks) {
+            ring->page->sq_flags |= URING_SQ_NEED_WAKEUP;
+            ring_barrier(); // set before the last look at sq_tail
+            wait_event(ring->sq_wait, ring->stop || uring_has_work(ring));
+            ring->page->sq_flags &= ~URING_SQ_NEED_WAKEUP;
+            idle_since = read_cntpct();
+            continue;
+        }
+        enable_interrupt(0x0); // let expired timers run while we poll
+        disable_interrupt();
+        schedule(); // still runnable: everyone else gets a turn first
+    }
+
+    self->pgd = own_pgd; // before the owner's tables can go away
+    switch_pgd(own_pgd);
+    self->ring = NULL;
+    ring->poller = NULL;
+    wake_up(&ring->cq_wait); // uring_release() waits for us
+    thread_exit();
+}
+
+// returns the user address of the shared page, -1 on error
+long uring_setup(unsigned int entries, unsigned int flags, unsigned long idle_us) {
+    thread_t *self = current_thread;
+    if (self->ring != NULL) {
+        return -1; // one ring per process
+    }
+    if (entries == 0 || entries > URING_ENTRIES || (entries & (entries - 1)) != 0) {
+        return -1; // Invalid argument
+    }
+
+    uring_t *ring = allocate(sizeof(uring_t));
+    if (ring == NULL) {
+        return -1;
+    }
+    ring->page = allocate(PAGE_SIZE);
+    if (ring->page == NULL) {
+        free(ring);
+        return -1;
+    }
+    memset((char *)ring->page, 0, PAGE_SIZE);
+    ring->page->entries = entries;
+    ring->owner = self;
+    ring->entries = entries;
+    ring->sq_head = 0;
+    ring->cq_tail = 0;
+    ring->poller = NULL;
+    ring->idle_ticks = us_to_ticks(idle_us != 0 ? idle_us : URING_SQPOLL_IDLE_US);
+    ring->stop = 0;
+    init_waitqueue_head(&ring->sq_wait);
+    init_waitqueue_head(&ring->cq_wait);
+
+    if (flags & URING_SETUP_SQPOLL) {
+        ring->poller = thread_create(uring_sqpoll, MEDIUM_PRIORITY, NULL, 0);
+        if (ring->poller == NULL) {
+            uart_send_string("[ERROR | URING] Failed to create the poll thread\r\n");
+            free(ring->page);
+            free(ring);
+            return -1;
+        }
+        ring->poller->ring = ring; // it can't run before we return to EL0
+    }
+    mappages(self->pgd, URING_USER_BASE, vtop((unsigned long)ring->page), PD_USR_ACCESS | PD_UNOX);
+    self->ring = ring;
+    return URING_USER_BASE;
+}
+
+// returns the number of entries submitted, -1 on error
+long uring_enter(unsigned int to_submit, unsigned int min_complete, unsigned int flags) {
+    uring_t *ring = current_thread->ring;
+    if (ring == NULL || ring->owner != current_thread) {
+        return -1;
+    }
+    long submitted;
+    if (ring->poller != NULL) {
+        if (flags & (URING_ENTER_SQ_WAKEUP | URING_ENTER_GETEVENTS)) {
+            wake_up(&ring->sq_wait); // a sleeping poller would never complete what we wait for
+        }
+        submitted = to_submit; // the poller consumes them
+    } else {
+        submitted = uring_submit(ring, to_submit);
+    }
+
+    // without a poller everything completed above, there is nothing to wait for
+    if ((flags & URING_ENTER_GETEVENTS) && ring->poller != NULL) {
+        if (min_complete > ring->entries) {
+            min_complete = ring->entries;
+        }
+        wait_event(ring->cq_wait, cq_ready(ring) >= min_complete || current_thread->killed);
+    }
+    return submitted;
+}
+
+/*
+    Called by the owner on exec and exit. stop alone only reaches a poller
+    idling on sq_wait; one blocked in a request is killed as well. Every
+    sleep a request can take gives up for a kill (pipe reads and writes,
+    UART reads), so the poller always gets back to its loop and sees stop.
+*/
+void uring_release(thread_t *t) {
+    uring_t *ring = t->ring;
+    if (ring == NULL || ring->owner != t) {
+        return;
+    }
+    thread_t *poller = ring->poller;
+    if (poller != NULL) {
+        ring->stop = 1;
+        poller->killed = 1; // a kernel thread never acts on it, it only cuts sleeps short
+        wake_up(&ring->sq_wait);
+        thread_wakeup(poller);
+        wait_event(ring->cq_wait, ring->poller == NULL);
+    }
+    unmappages(t->pgd, URING_USER_BASE);
+    free(ring->page);
+    free(ring);
+    t->ring = NULL;
+}
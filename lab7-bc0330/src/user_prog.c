@@ -4,20 +4,23 @@
 #include "mini_uart.h"
 #include "mmu.h"
 #include "rootfs.h"
+#include "schedstat.h"
 #include "thread.h"
 #include "user_prog.h"
 #include "utils.h"
 #include "vfs.h"
 
 void jump_user_prog(void *entry, void *user_stack) {
+    acct_return_to_user(current_thread);
     asm volatile (
         "mov x9, 0x0\n"
         "msr spsr_el1, x9\n" // daif = 0, interrupts enabled
-        "msr elr_el1, x0\n" // set the entry point
-        "msr sp_el0, x1\n"  // set the stack pointer
+        "msr elr_el1, %0\n" // set the entry point
+        "msr sp_el0, %1\n"  // set the stack pointer
         "eret\n"
         : // no output
         : "r" (entry), "r" (user_stack) // input
+        : "x9"
     );
 }
 
@@ -4,6 +4,8 @@
 #include "framebufferfs.h"
 #include "initramfs.h"
 #include "mini_uart.h"
+#include "poll.h"
+#include "spinlock.h"
 #include "thread.h"
 #include "tmpfs.h"
 #include "uartfs.h"
@@ -12,6 +14,8 @@
 
 struct mount* rootfs;
 struct filesystem* fs_list[8] = {NULL};
+static DEFINE_SPINLOCK(fs_list_lock); // protects fs_list
+static DEFINE_SPINLOCK(file_ref_lock); // protects struct file ref
 
 void init_vfs(void) {
     // init rootfs
@@ -115,26 +119,38 @@ void init_vfs(void) {
 
 }
 
-int register_filesystem(struct filesystem* fs) {
-    if (find_filesystem(fs->name) != NULL) {
-        return -1; // Filesystem already registered
-    }
+static struct filesystem* __find_filesystem(const char* name) {
     for (int i = 0; i < 8; ++i) {
-        if (fs_list[i] == NULL) {
-            fs_list[i] = fs;
-            return 0; // Successfully registered
+        if (fs_list[i] != NULL && strcmp(fs_list[i]->name, name)) {
+            return fs_list[i];
         }
     }
-    return -1; // No space to register filesystem
+    return NULL;
 }
 
-struct filesystem* find_filesystem(const char* name) {
-    for (int i = 0; i < 8; ++i) {
-        if (fs_list[i] != NULL && strcmp(fs_list[i]->name, name)) {
-            return fs_list[i];
+int register_filesystem(struct filesystem* fs) {
+    unsigned long flags;
+    int ret = -1; // No space to register filesystem
+    spin_lock_irqsave(&fs_list_lock, flags);
+    if (__find_filesystem(fs->name) == NULL) { // otherwise already registered
+        for (int i = 0; i < 8; ++i) {
+            if (fs_list[i] == NULL) {
+                fs_list[i] = fs;
+                ret = 0; // Successfully registered
+                break;
+            }
         }
     }
-    return NULL;
+    spin_unlock_irqrestore(&fs_list_lock, flags);
+    return ret;
+}
+
+struct filesystem* find_filesystem(const char* name) {
+    unsigned long flags;
+    spin_lock_irqsave(&fs_list_lock, flags);
+    struct filesystem* fs = __find_filesystem(name);
+    spin_unlock_irqrestore(&fs_list_lock, flags);
+    return fs;
 }
 
 // --- file operations ---
@@ -173,13 +189,74 @@ int vfs_open(const char* pathname, int flags, struct file** target) {
     (*target)->f_pos = 0;
     (*target)->vnode = node;
     (*target)->f_ops = node->f_ops;
+    (*target)->ref = 1;
     return 0;
 }
 
+// the handle is released by the filesystem when the last reference is closed
 int vfs_close(struct file* file) {
+    unsigned long flags;
+    spin_lock_irqsave(&file_ref_lock, flags);
+    int ref = --file->ref;
+    spin_unlock_irqrestore(&file_ref_lock, flags);
+    if (ref > 0) {
+        return 0;
+    }
     return file->f_ops->close(file);
 }
 
+// share an open handle (and its position) instead of opening the path again
+struct file* vfs_dup(struct file* file) {
+    unsigned long flags;
+    spin_lock_irqsave(&file_ref_lock, flags);
+    file->ref++;
+    spin_unlock_irqrestore(&file_ref_lock, flags);
+    return file;
+}
+
+// put file in t's lowest free slot, returns the fd or -1 if the table is full
+int fd_install(struct thread* t, struct file* file) {
+    unsigned long flags;
+    spin_lock_irqsave(&t->files_lock, flags);
+    for (int i = 0; i < MAX_FD; ++i) {
+        if (t->files_table[i] == NULL) {
+            t->files_table[i] = file;
+            spin_unlock_irqrestore(&t->files_lock, flags);
+            return i;
+        }
+    }
+    spin_unlock_irqrestore(&t->files_lock, flags);
+    return -1;
+}
+
+// the file open at fd with a new reference for the caller to vfs_close(), NULL if none
+struct file* fd_get(struct thread* t, int fd) {
+    if (fd < 0 || fd >= MAX_FD) {
+        return NULL;
+    }
+    unsigned long flags;
+    spin_lock_irqsave(&t->files_lock, flags);
+    struct file *file = t->files_table[fd];
+    if (file != NULL) {
+        vfs_dup(file);
+    }
+    spin_unlock_irqrestore(&t->files_lock, flags);
+    return file;
+}
+
+// empty the slot, returns the table's reference for the caller to vfs_close(), NULL if none
+struct file* fd_remove(struct thread* t, int fd) {
+    if (fd < 0 || fd >= MAX_FD) {
+        return NULL;
+    }
+    unsigned long flags;
+    spin_lock_irqsave(&t->files_lock, flags);
+    struct file *file = t->files_table[fd];
+    t->files_table[fd] = NULL;
+    spin_unlock_irqrestore(&t->files_lock, flags);
+    return file;
+}
+
 int vfs_write(struct file* file, const void* buf, size_t len) {
     return file->f_ops->write(file, buf, len);
 }
@@ -188,6 +265,114 @@ int vfs_read(struct file* file, void* buf, size_t len) {
     return file->f_ops->read(file, buf, len);
 }
 
+long vfs_lseek64(struct file* file, long offset, int whence) {
+    return file->f_ops->lseek64(file, offset, whence);
+}
+
+unsigned int vfs_poll(struct file* file, struct poll_table* pt) {
+    if (file->f_ops->poll == NULL) {
+        return POLLIN | POLLOUT; // never blocks
+    }
+    return file->f_ops->poll(file, pt);
+}
+
+/*
+    lseek64 for files with a known size: the new position may go past the
+    end, up to max, where reads return 0. Returns the new position or -1.
+*/
+long generic_file_lseek(struct file* file, long offset, int whence, size_t size, size_t max) {
+    long base;
+    switch (whence) {
+        case SEEK_SET:
+            base = 0;
+            break;
+        case SEEK_CUR:
+            base = (long)file->f_pos;
+            break;
+        case SEEK_END:
+            base = (long)size;
+            break;
+        default:
+            return -1; // Invalid whence
+    }
+    long pos = base + offset;
+    if (pos < 0 || (size_t)pos > max) {
+        return -1; // Out of range
+    }
+    file->f_pos = (size_t)pos;
+    return pos;
+}
+
+// read at pos without moving the file position
+int vfs_pread(struct file* file, void* buf, size_t len, size_t pos) {
+    if (file->f_ops->pread != NULL) {
+        return file->f_ops->pread(file, buf, len, pos);
+    }
+    size_t saved = file->f_pos;
+    if (vfs_lseek64(file, (long)pos, SEEK_SET) < 0) {
+        return -1; // not seekable
+    }
+    int bytes_read = vfs_read(file, buf, len);
+    file->f_pos = saved;
+    return bytes_read;
+}
+
+int vfs_pwrite(struct file* file, const void* buf, size_t len, size_t pos) {
+    if (file->f_ops->pwrite != NULL) {
+        return file->f_ops->pwrite(file, buf, len, pos);
+    }
+    size_t saved = file->f_pos;
+    if (vfs_lseek64(file, (long)pos, SEEK_SET) < 0) {
+        return -1; // not seekable
+    }
+    int bytes_written = vfs_write(file, buf, len);
+    file->f_pos = saved;
+    return bytes_written;
+}
+
+// stops at the first short transfer; -1 only if nothing was transferred
+long vfs_readv(struct file* file, const struct iovec* iov, int iovcnt) {
+    if (file->f_ops->readv != NULL) {
+        return file->f_ops->readv(file, iov, iovcnt);
+    }
+    long total = 0;
+    for (int i = 0; i < iovcnt; ++i) {
+        if (iov[i].iov_len == 0) {
+            continue;
+        }
+        int bytes_read = vfs_read(file, iov[i].iov_base, iov[i].iov_len);
+        if (bytes_read < 0) {
+            return total != 0 ? total : -1;
+        }
+        total += bytes_read;
+        if ((size_t)bytes_read < iov[i].iov_len) {
+            break; // end of file
+        }
+    }
+    return total;
+}
+
+long vfs_writev(struct file* file, const struct iovec* iov, int iovcnt) {
+    if (file->f_ops->writev != NULL) {
+        return file->f_ops->writev(file, iov, iovcnt);
+    }
+    long total = 0;
+    for (int i = 0; i < iovcnt; ++i) {
+        if (iov[i].iov_len == 0) {
+            continue;
+        }
+        int bytes_written = vfs_write(file, iov[i].iov_base, iov[i].iov_len);
+        if (bytes_written < 0) {
+            return total != 0 ? total : -1;
+        }
+        total += bytes_written;
+        if ((size_t)bytes_written < iov[i].iov_len) {
+            break; // file is full
+        }
+    }
+    return total;
+}
+
 // --- vnode operations ---
 int vfs_mkdir(const char* pathname) {
     char parent_path[MAX_PATH_LEN] = {0}, child_name[MAX_COMPONENT_LEN + 1] = {0};
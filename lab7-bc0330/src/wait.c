@@ -0,0 +1,87 @@
+#include <stddef.h>
+#include "exception_handler.h"
+#include "spinlock.h"
+#include "thread.h"
+#include "wait.h"
+
+void init_waitqueue_head(wait_queue_head_t *wq) {
+    spin_lock_init(&wq->lock, "wait_queue");
+    wq->head = NULL;
+    wq->tail = NULL;
+}
+
+void init_wait_entry(wait_queue_entry_t *entry) {
+    entry->task = current_thread;
+    entry->prev = NULL;
+    entry->next = NULL;
+    entry->queued = 0;
+}
+
+static void __add_wait_queue(wait_queue_head_t *wq, wait_queue_entry_t *entry) {
+    entry->next = NULL;
+    entry->prev = wq->tail;
+    if (wq->tail != NULL) {
+        wq->tail->next = entry;
+    } else {
+        wq->head = entry;
+    }
+    wq->tail = entry;
+    entry->queued = 1;
+}
+
+void add_wait_queue(wait_queue_head_t *wq, wait_queue_entry_t *entry) {
+    unsigned long flags;
+    spin_lock_irqsave(&wq->lock, flags);
+    __add_wait_queue(wq, entry);
+    spin_unlock_irqrestore(&wq->lock, flags);
+}
+
+void remove_wait_queue(wait_queue_head_t *wq, wait_queue_entry_t *entry) {
+    unsigned long flags;
+    spin_lock_irqsave(&wq->lock, flags);
+    if (entry->queued) {
+        if (entry->prev != NULL) {
+            entry->prev->next = entry->next;
+        } else {
+            wq->head = entry->next;
+        }
+        if (entry->next != NULL) {
+            entry->next->prev = entry->prev;
+        } else {
+            wq->tail = entry->prev;
+        }
+        entry->prev = NULL;
+        entry->next = NULL;
+        entry->queued = 0;
+    }
+    spin_unlock_irqrestore(&wq->lock, flags);
+}
+
+/*
+    The state is set under the queue lock, so a wake_up() running
+    concurrently either sees us queued and WAITING or runs before we
+    re-check the condition.
+*/
+void prepare_to_wait(wait_queue_head_t *wq, wait_queue_entry_t *entry) {
+    unsigned long flags;
+    spin_lock_irqsave(&wq->lock, flags);
+    if (!entry->queued) {
+        __add_wait_queue(wq, entry);
+    }
+    current_thread->state = THREAD_WAITING; // schedule() won't requeue us
+    spin_unlock_irqrestore(&wq->lock, flags);
+}
+
+void finish_wait(wait_queue_head_t *wq, wait_queue_entry_t *entry) {
+    current_thread->state = THREAD_RUNNING;
+    remove_wait_queue(wq, entry);
+}
+
+void wake_up(wait_queue_head_t *wq) {
+    unsigned long flags;
+    spin_lock_irqsave(&wq->lock, flags);
+    for (wait_queue_entry_t *entry = wq->head; entry != NULL; entry = entry->next) {
+        thread_wakeup(entry->task); // sleepers dequeue themselves in finish_wait()
+    }
+    spin_unlock_irqrestore(&wq->lock, flags);
+}
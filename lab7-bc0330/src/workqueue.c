@@ -0,0 +1,84 @@
+#include <stddef.h>
+#include "spinlock.h"
+#include "thread.h"
+#include "wait.h"
+#include "workqueue.h"
+
+struct workqueue_struct {
+    struct work_struct *head;   // FIFO of queued work
+    struct work_struct *tail;
+    spinlock_t lock;
+    wait_queue_head_t wait;     // the worker sleeps here until work is queued
+};
+
+static struct workqueue_struct system_workqueue;
+static struct workqueue_struct system_lowpri_workqueue;
+struct workqueue_struct *system_wq = &system_workqueue;
+struct workqueue_struct *system_lowpri_wq = &system_lowpri_workqueue;
+
+void init_work(struct work_struct *work, void (*func)(struct work_struct *work)) {
+    work->next = NULL;
+    work->pending = 0;
+    work->func = func;
+}
+
+// 1 if queued, 0 if it was already pending
+int queue_work(struct workqueue_struct *wq, struct work_struct *work) {
+    unsigned long flags;
+    int queued = 0;
+    spin_lock_irqsave(&wq->lock, flags);
+    if (!work->pending) {
+        work->pending = 1;
+        work->next = NULL;
+        if (wq->tail != NULL) {
+            wq->tail->next = work;
+        } else {
+            wq->head = work;
+        }
+        wq->tail = work;
+        queued = 1;
+    }
+    spin_unlock_irqrestore(&wq->lock, flags);
+    if (queued) {
+        wake_up(&wq->wait);
+    }
+    return queued;
+}
+
+static void worker_loop(struct workqueue_struct *wq) {
+    while (1) {
+        wait_event(wq->wait, wq->head != NULL);
+        unsigned long flags;
+        spin_lock_irqsave(&wq->lock, flags);
+        struct work_struct *work = wq->head;
+        wq->head = work->next;
+        if (wq->head == NULL) {
+            wq->tail = NULL;
+        }
+        work->pending = 0; // may be queued again while it runs
+        spin_unlock_irqrestore(&wq->lock, flags);
+        work->func(work);
+    }
+}
+
+static void kworker(void) {
+    worker_loop(system_wq);
+}
+
+static void kworker_lowpri(void) {
+    worker_loop(system_lowpri_wq);
+}
+
+static void init_wq(struct workqueue_struct *wq, const char *name) {
+    wq->head = NULL;
+    wq->tail = NULL;
+    spin_lock_init(&wq->lock, name);
+    init_waitqueue_head(&wq->wait);
+}
+
+void init_workqueue(void) {
+    init_wq(system_wq, "system_wq");
+    init_wq(system_lowpri_wq, "system_lowpri_wq");
+    thread_create(kworker, MEDIUM_PRIORITY, NULL, 0);
+    thread_create(kworker_lowpri, LOW_PRIORITY, NULL, 0);
+}